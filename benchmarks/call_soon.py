@@ -0,0 +1,69 @@
+#!/usr/bin/python -u
+#
+# Benchmark for handing work from other threads to a running base.
+#
+# A number of producer threads submit completions to the loop, either with
+# Base.call_soon_threadsafe() or by creating and adding a new Event with a
+# minimal timeout for every completion. The script reports how many
+# completions are run by the loop per second.
+#
+# Usage: call_soon.py [num_completions] [num_threads] [event]
+#
+# Passing "event" uses a new Event per completion instead.
+#
+import sys
+import threading
+import time
+
+import libevent
+
+def run(num_completions, num_threads, use_events=False):
+    base = libevent.Base()
+    done = [0]
+    total = num_completions * num_threads
+    def completed(*args):
+        done[0] += 1
+        if done[0] == total:
+            base.loopbreak()
+
+    def produce_soon():
+        for i in xrange(num_completions):
+            base.call_soon_threadsafe(completed, i)
+
+    def produce_events():
+        for i in xrange(num_completions):
+            evt = libevent.Event(base, -1, 0, completed)
+            evt.add(0.000001)
+            # the event must be referenced until it fired
+            pending.append(evt)
+
+    pending = []
+    keepalive = libevent.Event(base, -1, libevent.EV_PERSIST, lambda *args: None)
+    keepalive.add(60)
+    target = use_events and produce_events or produce_soon
+    threads = [threading.Thread(target=target) for i in xrange(num_threads)]
+    start = time.time()
+    for thread in threads:
+        thread.start()
+    base.loop()
+    elapsed = time.time() - start
+    for thread in threads:
+        thread.join()
+    keepalive.delete()
+    return total / elapsed, base
+
+def main():
+    num_completions = 100000
+    num_threads = 2
+    if len(sys.argv) > 1:
+        num_completions = int(sys.argv[1])
+    if len(sys.argv) > 2:
+        num_threads = int(sys.argv[2])
+    use_events = len(sys.argv) > 3 and sys.argv[3] == 'event'
+
+    rate, base = run(num_completions, num_threads, use_events)
+    stats = base.stats()
+    print '%d threads: %.0f completions/sec in %d loop iterations' % (num_threads, rate, stats['loop_iterations'])
+
+if __name__ == '__main__':
+    main()
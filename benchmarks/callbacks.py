@@ -0,0 +1,59 @@
+#!/usr/bin/python -u
+#
+# Microbenchmark for the callback dispatch path.
+#
+# A number of persistent read events are registered on a pipe that always
+# has data available, so every loop iteration dispatches all of them. The
+# script reports how many Python callbacks are executed per second.
+#
+# Usage: callbacks.py [num_events] [duration] [batch]
+#
+# Passing "batch" enables GIL batching on the base.
+#
+import os
+import sys
+import time
+
+import libevent
+
+def fired(evt, fd, what, counter):
+    counter[0] += 1
+
+def run(num_events, duration, batch=False):
+    base = libevent.Base()
+    base.set_gil_batching(batch)
+    rfd, wfd = os.pipe()
+    os.write(wfd, 'x')
+    counter = [0]
+    events = []
+    for i in xrange(num_events):
+        evt = libevent.Event(base, rfd, libevent.EV_READ|libevent.EV_PERSIST, fired, counter)
+        evt.add()
+        events.append(evt)
+
+    base.loopexit(duration)
+    start = time.time()
+    base.loop()
+    elapsed = time.time() - start
+    for evt in events:
+        evt.delete()
+    os.close(rfd)
+    os.close(wfd)
+    return counter[0] / elapsed, base
+
+def main():
+    num_events = 100
+    duration = 2.0
+    if len(sys.argv) > 1:
+        num_events = int(sys.argv[1])
+    if len(sys.argv) > 2:
+        duration = float(sys.argv[2])
+    batch = len(sys.argv) > 3 and sys.argv[3] == 'batch'
+
+    rate, base = run(num_events, duration, batch)
+    print '%d events: %.0f callbacks/sec' % (num_events, rate)
+    if batch:
+        print 'GIL handoffs saved per iteration: %.1f' % (float(base.gil_handoffs_saved) / max(base.gil_batches, 1))
+
+if __name__ == '__main__':
+    main()
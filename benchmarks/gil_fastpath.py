@@ -0,0 +1,53 @@
+#!/usr/bin/python -u
+#
+# Benchmark for the cost of releasing the GIL around trivial libevent calls.
+#
+# Calls that can't block keep the GIL on bases created with
+# EVENT_BASE_FLAG_NOLOCK and on buffers without locking. The script measures
+# the time per call of Buffer and Event methods on a default base and a
+# locked buffer against a NOLOCK base and an unlocked buffer.
+#
+# Usage: gil_fastpath.py [num_calls]
+#
+import sys
+import time
+
+import libevent
+
+def measure(func, num_calls):
+    start = time.time()
+    for i in xrange(num_calls):
+        func()
+    return (time.time() - start) / num_calls * 1e9
+
+def run(num_calls):
+    config = libevent.Config()
+    config.set_flag(libevent.EVENT_BASE_FLAG_NOLOCK)
+    bases = [('default', libevent.Base()), ('nolock', libevent.Base(config))]
+    noop = lambda *args: None
+    results = []
+    for name, base in bases:
+        buf = libevent.Buffer()
+        buf.add('data')
+        if not base.nolock:
+            buf.enable_locking()
+        evt = libevent.Timer(base, noop)
+        def add_delete():
+            evt.add(60)
+            evt.delete()
+        results.append((name, [
+            ('len(Buffer)', measure(lambda: len(buf), num_calls)),
+            ('Event.add/delete', measure(add_delete, num_calls)),
+            ('Base.got_exit', measure(base.got_exit, num_calls)),
+        ]))
+
+    (_, default), (_, nolock) = results
+    for (label, slow), (_, fast) in zip(default, nolock):
+        print '%-18s %7.1f ns -> %7.1f ns per call (%.1f ns saved)' % (
+            label, slow, fast, slow - fast)
+
+if __name__ == '__main__':
+    num_calls = 1000000
+    if len(sys.argv) > 1:
+        num_calls = int(sys.argv[1])
+    run(num_calls)
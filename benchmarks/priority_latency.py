@@ -0,0 +1,90 @@
+#!/usr/bin/python -u
+#
+# Benchmark for the latency of high-priority events under a flood of
+# low-priority callbacks.
+#
+# A number of persistent priority 1 read events are registered on a pipe
+# that always has data available. A thread writes to a second pipe at a
+# fixed rate, which is watched by a priority 0 event. The script reports
+# the latency between the write and the priority 0 callback.
+#
+# Usage: priority_latency.py [num_events] [duration] [max_callbacks]
+#
+# Passing max_callbacks configures the base to check for higher-priority
+# events after that many callbacks.
+#
+import os
+import sys
+import threading
+import time
+
+import libevent
+
+def busy(evt, fd, what, userdata):
+    # simulate some work in the low-priority handler
+    sum(xrange(200))
+
+def run(num_events, duration, max_callbacks=None):
+    cfg = libevent.Config()
+    if max_callbacks is not None:
+        cfg.set_max_dispatch_interval(None, max_callbacks, 1)
+    base = libevent.Base(cfg)
+    base.priority_init(2)
+    latency = libevent.Histogram()
+    sent = []
+    running = [True]
+
+    flood_r, flood_w = os.pipe()
+    os.write(flood_w, 'x')
+    events = []
+    for i in xrange(num_events):
+        evt = libevent.Event(base, flood_r, libevent.EV_READ|libevent.EV_PERSIST, busy)
+        evt.set_priority(1)
+        evt.add()
+        events.append(evt)
+
+    high_r, high_w = os.pipe()
+    def control(evt, fd, what, userdata):
+        os.read(fd, 1)
+        latency.record(time.time() - sent.pop(0))
+    high = libevent.Event(base, high_r, libevent.EV_READ|libevent.EV_PERSIST, control)
+    high.set_priority(0)
+    high.add()
+
+    def writer():
+        while running[0]:
+            sent.append(time.time())
+            os.write(high_w, 'x')
+            time.sleep(0.005)
+
+    thread = threading.Thread(target=writer)
+    thread.start()
+    base.loopexit(duration)
+    base.loop()
+    running[0] = False
+    thread.join()
+    for evt in events:
+        evt.delete()
+    high.delete()
+    for fd in (flood_r, flood_w, high_r, high_w):
+        os.close(fd)
+    return latency
+
+def main():
+    num_events = 1000
+    duration = 2.0
+    max_callbacks = None
+    if len(sys.argv) > 1:
+        num_events = int(sys.argv[1])
+    if len(sys.argv) > 2:
+        duration = float(sys.argv[2])
+    if len(sys.argv) > 3:
+        max_callbacks = int(sys.argv[3])
+
+    latency = run(num_events, duration, max_callbacks)
+    print '%d events, max_callbacks %s: %d samples, p50 %.3f ms, p99 %.3f ms, max %.3f ms' % (
+        num_events, max_callbacks, latency.count, latency.percentile(50) * 1000,
+        latency.percentile(99) * 1000, latency.max() * 1000)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,84 @@
+#!/usr/bin/python -u
+#
+# Benchmark for large numbers of pending timeouts.
+#
+# Arms a number of timers with random delays between one and ten minutes,
+# either in a TimerWheel or as one Event per timer, and cancels them all
+# again. The script reports the memory used per armed timer and the time
+# needed to arm and cancel a timer.
+#
+# Usage: timerwheel.py [num_timers] [wheel|event]
+#
+import gc
+import os
+import random
+import resource
+import sys
+import time
+
+import libevent
+
+def rss():
+    # current resident set size in bytes
+    f = open('/proc/self/statm')
+    try:
+        return int(f.read().split()[1]) * resource.getpagesize()
+    finally:
+        f.close()
+
+def fired(*args):
+    pass
+
+def run_wheel(base, delays):
+    wheel = libevent.TimerWheel(base, 0.01)
+    start = time.time()
+    ids = [wheel.add(delay, fired) for delay in delays]
+    armed = time.time() - start
+    # the ids are only kept to cancel the timers
+    memory = rss()
+    start = time.time()
+    for id in ids:
+        wheel.cancel(id)
+    cancelled = time.time() - start
+    return armed, memory, cancelled, ids
+
+def run_events(base, delays):
+    events = []
+    start = time.time()
+    for delay in delays:
+        evt = libevent.Timer(base, fired)
+        evt.add(delay)
+        events.append(evt)
+    armed = time.time() - start
+    memory = rss()
+    start = time.time()
+    for evt in events:
+        evt.delete()
+    cancelled = time.time() - start
+    return armed, memory, cancelled, events
+
+def main():
+    num_timers = 1000000
+    mode = 'wheel'
+    if len(sys.argv) > 1:
+        num_timers = int(sys.argv[1])
+    if len(sys.argv) > 2:
+        mode = sys.argv[2]
+
+    random.seed(0)
+    delays = [random.uniform(60, 600) for i in xrange(num_timers)]
+    base = libevent.Base()
+    gc.collect()
+    gc.disable()
+    # the list of handles is accounted to both variants
+    baseline = rss() + len(delays) * 8
+    if mode == 'event':
+        armed, memory, cancelled, handles = run_events(base, delays)
+    else:
+        armed, memory, cancelled, handles = run_wheel(base, delays)
+    print '%s: %d timers, %.0f bytes/timer, arm %.2f us/timer, cancel %.2f us/timer' % (
+        mode, num_timers, float(memory - baseline) / num_timers,
+        armed * 1000000 / num_timers, cancelled * 1000000 / num_timers)
+
+if __name__ == '__main__':
+    main()
@@ -1,38 +1,420 @@
 from _libevent import *
+import errno
+import itertools
+import json
+import os
+import signal
+import socket
+import sys
+import threading
+import time
+import traceback
 import weakref
+try:
+    import fcntl
+except ImportError:
+    fcntl = None
 
-class Timer(Event):
-    """Simplified class for timers."""
-    
-    __slots__ = ('_callback')
-    
-    def __init__(self, base, callback, userdata=None):
-        if not callable(callback):
-            raise TypeError("the callback must be callable")
-        
-        def _fire(evt, fd, what, userdata, selfref=weakref.ref(self)):
-            """Special internal class to prevent circular references."""
-            self = selfref()
-            if self is not None:
-                self._callback(self, userdata)
-        
-        super(Timer, self).__init__(base, -1, 0, _fire, userdata)
-        self._callback = callback
-
-class Signal(Event):
-    """Simplified class for signals."""
-    
-    __slots__ = ('_callback')
-    
-    def __init__(self, base, signum, callback, userdata=None):
+class BasePool(object):
+    """Run one event base per worker thread and distribute connections."""
+
+    ROUND_ROBIN = 'round-robin'
+    LEAST_LOADED = 'least-loaded'
+
+    # interval of the timer that keeps an idle worker loop running
+    _KEEPALIVE = 3600
+
+    def __init__(self, num_workers, strategy=ROUND_ROBIN, config=None):
+        if num_workers < 1:
+            raise TypeError("at least one worker is required")
+        if strategy not in (self.ROUND_ROBIN, self.LEAST_LOADED):
+            raise TypeError("unknown strategy %r" % (strategy, ))
+
+        if config is None:
+            self.bases = [Base() for i in xrange(num_workers)]
+        else:
+            self.bases = [Base(config) for i in xrange(num_workers)]
+        self.strategy = strategy
+        self._connections = [0] * num_workers
+        self._refs = set()
+        self._lock = threading.Lock()
+        self._next = itertools.cycle(xrange(num_workers))
+        self._threads = []
+        self._running = False
+
+    def start(self):
+        """Start the worker threads."""
+        if self._running:
+            raise TypeError("the pool is already running")
+
+        self._running = True
+        for idx, base in enumerate(self.bases):
+            thread = threading.Thread(target=self._run, args=(base, ),
+                name='BasePool-%d' % (idx))
+            thread.daemon = True
+            thread.start()
+            self._threads.append(thread)
+
+    def stop(self):
+        """Stop all worker threads and wait for them to finish."""
+        if not self._running:
+            return
+
+        self._running = False
+        for base in self.bases:
+            # Queued callbacks also reach a worker that is just entering
+            # its loop, a direct loopbreak() would be reset by it.
+            base.call_soon_threadsafe(base.loopbreak)
+        for thread in self._threads:
+            thread.join()
+        self._threads = []
+
+    def _run(self, base):
+        keepalive = Event(base, -1, EV_PERSIST, lambda *args: None)
+        keepalive.add(self._KEEPALIVE)
+        try:
+            while self._running:
+                try:
+                    base.loop()
+                except Exception:
+                    # Errors of callbacks must not stop the worker.
+                    sys.excepthook(*sys.exc_info())
+        finally:
+            keepalive.delete()
+
+    def connections(self):
+        """Return the number of open connections for every worker."""
+        self._lock.acquire()
+        try:
+            return list(self._connections)
+        finally:
+            self._lock.release()
+
+    def _select(self):
+        self._lock.acquire()
+        try:
+            if self.strategy == self.LEAST_LOADED:
+                idx = min(xrange(len(self._connections)), key=self._connections.__getitem__)
+            else:
+                idx = self._next.next()
+            self._connections[idx] += 1
+        finally:
+            self._lock.release()
+        return idx
+
+    def _release(self, idx, ref):
+        self._lock.acquire()
+        try:
+            self._refs.discard(ref)
+            self._connections[idx] -= 1
+        finally:
+            self._lock.release()
+
+    def dispatch(self, fd, callback, userdata=None, options=BEV_OPT_CLOSE_ON_FREE):
+        """Hand a connected socket to a worker.
+
+        A BufferEvent for the socket is created on the base of the selected
+        worker and passed to callback(bufferevent, userdata) in the thread
+        of that worker. The connection counts as open until the BufferEvent
+        is released.
+        """
         if not callable(callback):
             raise TypeError("the callback must be callable")
-        
-        def _fire(evt, fd, what, userdata, selfref=weakref.ref(self)):
-            """Special internal class to prevent circular references."""
-            self = selfref()
-            if self is not None:
-                self._callback(self, fd, userdata)
-        
-        super(Signal, self).__init__(base, signum, EV_SIGNAL|EV_PERSIST, _fire, userdata)
-        self._callback = callback
+
+        idx = self._select()
+        base = self.bases[idx]
+
+        def _connect(_, what, userdata):
+            try:
+                bev = BufferEvent(base, fd, options)
+            except:
+                _release(None)
+                raise
+
+            self._lock.acquire()
+            try:
+                self._refs.add(weakref.ref(bev, _release))
+            finally:
+                self._lock.release()
+            callback(bev, userdata)
+
+        def _release(ref, pool=weakref.ref(self)):
+            pool = pool()
+            if pool is not None:
+                pool._release(idx, ref)
+
+        try:
+            base.once(-1, EV_TIMEOUT, _connect, 0, userdata)
+        except:
+            self._release(idx, None)
+            raise
+        return base
+
+    def listen(self, base, fd, callback, userdata=None, backlog=-1,
+            flags=LEV_OPT_REUSEABLE|LEV_OPT_CLOSE_ON_FREE,
+            options=BEV_OPT_CLOSE_ON_FREE):
+        """Accept connections on fd in base and dispatch them to the workers.
+
+        The base running the Listener is driven by the caller, typically in
+        the main thread. The returned Listener must be kept alive by the
+        caller.
+        """
+        def _accepted(listener, fd, userdata, pool=weakref.ref(self)):
+            pool = pool()
+            if pool is not None:
+                pool.dispatch(fd, callback, userdata, options)
+
+        return Listener(base, _accepted, flags, backlog, fd, userdata)
+
+
+class _PreforkWorker(object):
+
+    def __init__(self, idx, fd):
+        self.idx = idx
+        self.fd = fd
+        self.event = None
+        self.started = time.time()
+        self.data = ''
+
+class PreforkServer(object):
+    """Serve listening sockets from forked worker processes.
+
+    The sockets are created once for the given (host, port) addresses. If
+    the platform supports SO_REUSEPORT, every worker binds its own listening
+    socket to the same address so the kernel balances the connections
+    between them, otherwise the workers accept on the inherited sockets.
+
+    Every worker runs setup(base, sockets, worker_index) and then the loop of
+    its base until it is stopped. The result of setup is kept alive while the
+    loop runs, so it can hold the Listener objects. Crashed workers are
+    restarted and report the statistics of their base to the supervisor,
+    see stats().
+    """
+
+    # workers that die sooner after being started are restarted with delay
+    _MIN_LIFETIME = 1.0
+
+    def __init__(self, num_workers, setup, addresses, backlog=128,
+            config=None, stats_interval=1.0):
+        if not hasattr(os, 'fork'):
+            raise TypeError("forking is not supported on this platform")
+        if num_workers < 1:
+            raise TypeError("at least one worker is required")
+        if not callable(setup):
+            raise TypeError("the setup must be callable")
+
+        self.num_workers = num_workers
+        self.setup = setup
+        self.backlog = backlog
+        self.config = config
+        self.stats_interval = stats_interval
+        self.reuse_port = 'SO_REUSEPORT' in globals()
+        self.sockets = []
+        for host, port in addresses:
+            family, _, _, _, address = socket.getaddrinfo(host, port,
+                socket.AF_UNSPEC, socket.SOCK_STREAM, 0, socket.AI_PASSIVE)[0]
+            # Only the sockets of the workers listen when using SO_REUSEPORT,
+            # the sockets of the supervisor just reserve the addresses.
+            self.sockets.append(self._bind(family, address, not self.reuse_port))
+        self.addresses = [sock.getsockname() for sock in self.sockets]
+        self.base = Base()
+        self.restarts = 0
+        self._workers = {}
+        self._stats = {}
+        self._signals = []
+        self._running = False
+
+    def _bind(self, family, address, listen):
+        sock = socket.socket(family, socket.SOCK_STREAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        if self.reuse_port:
+            sock.setsockopt(socket.SOL_SOCKET, SO_REUSEPORT, 1)
+        sock.bind(address)
+        if listen:
+            sock.listen(self.backlog)
+        sock.setblocking(0)
+        return sock
+
+    def run(self):
+        """Start the workers and supervise them until stop() is called."""
+        if self._running:
+            raise TypeError("the server is already running")
+
+        self._running = True
+        self._signals = [Signal(self.base, signum, self._signaled)
+            for signum in (signal.SIGCHLD, signal.SIGTERM, signal.SIGINT)]
+        for evt in self._signals:
+            evt.add()
+        try:
+            for idx in xrange(self.num_workers):
+                self._spawn(idx)
+            self.base.loop()
+        finally:
+            self._running = False
+            for evt in self._signals:
+                evt.delete()
+            self._signals = []
+            for pid in self._workers.keys():
+                self._kill(pid)
+                os.waitpid(pid, 0)
+                self._remove(pid)
+
+    def stop(self):
+        """Terminate the workers, run() returns once all of them exited.
+
+        Must be called from a callback of the base of the supervisor.
+        """
+        self._running = False
+        if not self._workers:
+            self.base.loopbreak()
+            return
+
+        for pid in self._workers:
+            self._kill(pid)
+
+    def workers(self):
+        """Return the process ids of the running workers."""
+        return self._workers.keys()
+
+    def stats(self):
+        """Return the sum of the latest statistics of all workers."""
+        result = {}
+        for stats in self._stats.itervalues():
+            for key, value in stats.iteritems():
+                key = str(key)
+                result[key] = result.get(key, 0) + value
+        result['workers'] = len(self._workers)
+        result['restarts'] = self.restarts
+        return result
+
+    def _kill(self, pid):
+        try:
+            os.kill(pid, signal.SIGTERM)
+        except OSError:
+            pass
+
+    def _spawn(self, idx):
+        # The base is reinitialized in the child, so the backend of the
+        # supervisor is never touched by a worker.
+        if self.config is None:
+            base = Base()
+        else:
+            base = Base(self.config)
+        rfd, wfd = os.pipe()
+        pid = os.fork()
+        if pid == 0:
+            os.close(rfd)
+            self._work(idx, base, wfd)
+
+        os.close(wfd)
+        worker = _PreforkWorker(idx, rfd)
+        worker.event = Event(self.base, rfd, EV_READ|EV_PERSIST, self._received, worker)
+        worker.event.add()
+        self._workers[pid] = worker
+
+    def _remove(self, pid):
+        worker = self._workers.pop(pid)
+        worker.event.delete()
+        if worker.fd is not None:
+            os.close(worker.fd)
+        return worker
+
+    def _work(self, idx, base, fd):
+        status = 1
+        try:
+            # The signal handlers of the supervisor would notify its base.
+            signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+            signal.signal(signal.SIGTERM, signal.SIG_DFL)
+            signal.signal(signal.SIGINT, signal.SIG_IGN)
+            # Only one base can have signals at a time, so the inherited
+            # ones of the supervisor are released before adding our own.
+            for evt in self._signals:
+                evt.delete()
+            self._signals = []
+            self.base = None
+            base.reinit()
+            for worker in self._workers.itervalues():
+                if worker.fd is not None:
+                    os.close(worker.fd)
+            if self.reuse_port:
+                sockets = [self._bind(sock.family, address, True)
+                    for sock, address in zip(self.sockets, self.addresses)]
+                for sock in self.sockets:
+                    sock.close()
+            else:
+                sockets = self.sockets
+            if fcntl is not None:
+                fcntl.fcntl(fd, fcntl.F_SETFL,
+                    fcntl.fcntl(fd, fcntl.F_GETFL) | os.O_NONBLOCK)
+
+            stop = Signal(base, signal.SIGTERM,
+                lambda evt, signum, userdata: base.loopbreak())
+            stop.add()
+            report = PeriodicTimer(base, self.stats_interval, self._report, fd)
+            report.start(0)
+            keep = self.setup(base, sockets, idx)
+            base.loop()
+            status = 0
+        except:
+            traceback.print_exc()
+        finally:
+            # Never return into the loop of the supervisor.
+            os._exit(status)
+
+    def _report(self, timer, fd):
+        try:
+            os.write(fd, json.dumps(timer.base.stats()) + '\n')
+        except OSError, e:
+            if e.errno == errno.EPIPE:
+                # The supervisor is gone
+                timer.base.loopbreak()
+            elif e.errno != errno.EAGAIN:
+                raise
+
+    def _received(self, evt, fd, what, worker):
+        data = os.read(fd, 65536)
+        if not data:
+            evt.delete()
+            os.close(fd)
+            worker.fd = None
+            return
+
+        lines = (worker.data + data).split('\n')
+        worker.data = lines.pop()
+        if lines:
+            self._stats[worker.idx] = json.loads(lines[-1])
+
+    def _restart(self, fd, what, idx):
+        if self._running:
+            self._spawn(idx)
+
+    def _signaled(self, evt, signum, userdata):
+        if signum != signal.SIGCHLD:
+            self.stop()
+            return
+
+        for pid in self._workers.keys():
+            if os.waitpid(pid, os.WNOHANG)[0] == 0:
+                continue
+
+            worker = self._remove(pid)
+            if self._running:
+                self.restarts += 1
+                delay = 0
+                if time.time() - worker.started < self._MIN_LIFETIME:
+                    delay = self._MIN_LIFETIME
+                self.base.once(-1, EV_TIMEOUT, self._restart, delay, worker.idx)
+            else:
+                self._stats.pop(worker.idx, None)
+
+        if not self._running and not self._workers:
+            self.base.loopbreak()
+
+def prefork(num_workers, setup, addresses, **kwargs):
+    """Run a PreforkServer until it is stopped by SIGTERM or SIGINT.
+
+    See PreforkServer for the arguments.
+    """
+    server = PreforkServer(num_workers, setup, addresses, **kwargs)
+    server.run()
+    return server
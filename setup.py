@@ -46,8 +46,10 @@ c_files = [
     'src/pybuffer.c',
     'src/pybufferevent.c',
     'src/pyevent.c',
+    'src/pyhistogram.c',
     'src/pyhttp.c',
     'src/pylistener.c',
+    'src/pytimerwheel.c',
 ]
 include_dirs = [
     os.path.join(LIBEVENT_ROOT, 'include'),
@@ -28,6 +28,9 @@
 #if defined(WITH_THREAD)
 #include <event2/thread.h>
 #endif
+#if !defined(WIN32)
+#include <sys/socket.h>
+#endif
 
 #include "pybase.h"
 #include "pyevent.h"
@@ -35,6 +38,8 @@
 #include "pybufferevent.h"
 #include "pyhttp.h"
 #include "pylistener.h"
+#include "pyhistogram.h"
+#include "pytimerwheel.h"
 
 #if !defined(PyModule_AddIntMacro)
 #define PyModule_AddIntMacro(module, name)      PyModule_AddIntConstant(module, #name, name);
@@ -90,6 +95,32 @@ _pylog_callback(int severity, const char *msg)
     END_BLOCK_THREADS
 }
 
+// Send a message of the bindings through the log callback, must be
+// called with the GIL held.
+void
+pylog_message(int severity, const char *msg)
+{
+    if (pylog_callback != NULL) {
+        _pylog_callback(severity, msg);
+    }
+}
+
+// The callbacks of libevent are process-wide and run with the thread
+// state of PyGILState_Ensure, which belongs to the main interpreter.
+static int
+check_main_interpreter(void)
+{
+    PyInterpreterState *interp = PyInterpreterState_Head();
+    while (PyInterpreterState_Next(interp) != NULL) {
+        interp = PyInterpreterState_Next(interp);
+    }
+    if (PyThreadState_GET()->interp != interp) {
+        PyErr_SetString(PyExc_TypeError, "the callback can only be set by the main interpreter");
+        return -1;
+    }
+    return 0;
+}
+
 static PyObject *
 set_log_callback(PyObject *self, PyObject *args)
 {
@@ -99,6 +130,9 @@ set_log_callback(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O", &cb))
         return NULL;
     
+    if (check_main_interpreter() != 0)
+        return NULL;
+    
     if (cb != Py_None && !PyCallable_Check(cb)) {
         PyErr_Format(PyExc_TypeError, "expected a callable or None, not %s", cb->ob_type->tp_name);
         return NULL;
@@ -147,6 +181,9 @@ set_fatal_callback(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O", &cb))
         return NULL;
     
+    if (check_main_interpreter() != 0)
+        return NULL;
+    
     if (cb != Py_None && !PyCallable_Check(cb)) {
         PyErr_Format(PyExc_TypeError, "expected a callable or None, not %s", cb->ob_type->tp_name);
         return NULL;
@@ -171,6 +208,64 @@ set_fatal_callback(PyObject *self, PyObject *args)
     Py_RETURN_NONE;
 }
 
+static PyFreeList *freelists[] = {
+    &pyevent_freelist,
+    &pybuffer_freelist,
+    &pyhttp_request_freelist,
+    NULL,
+};
+
+static PyObject *
+freelist_stats(PyObject *self, PyObject *args)
+{
+    PyFreeList **list;
+    PyObject *result = PyDict_New();
+    if (result == NULL) {
+        return NULL;
+    }
+    
+    for (list = freelists; *list != NULL; list++) {
+        PyObject *stats = Py_BuildValue("{sisisksk}",
+            "size", (*list)->size,
+            "max_size", (*list)->max_size,
+            "hits", (*list)->hits,
+            "misses", (*list)->misses);
+        if (stats == NULL || PyDict_SetItemString(result, (*list)->name, stats) != 0) {
+            Py_XDECREF(stats);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(stats);
+    }
+    return result;
+}
+
+static PyObject *
+set_freelist_size(PyObject *self, PyObject *args)
+{
+    PyFreeList **list;
+    const char *name;
+    int max_size;
+    
+    if (!PyArg_ParseTuple(args, "si", &name, &max_size))
+        return NULL;
+    
+    if (max_size < 0) {
+        PyErr_SetString(PyExc_TypeError, "the size must not be negative");
+        return NULL;
+    }
+    
+    for (list = freelists; *list != NULL; list++) {
+        if (strcmp((*list)->name, name) == 0) {
+            pyfreelist_resize(*list, max_size);
+            Py_RETURN_NONE;
+        }
+    }
+    
+    PyErr_Format(PyExc_TypeError, "unknown freelist %s", name);
+    return NULL;
+}
+
 PyMethodDef
 methods[] = {
     // exported functions
@@ -179,6 +274,8 @@ methods[] = {
     {"socket_error_to_string", (PyCFunction)socket_error_to_string, METH_VARARGS, NULL},
     {"set_log_callback", (PyCFunction)set_log_callback, METH_VARARGS, NULL},
     {"set_fatal_callback", (PyCFunction)set_fatal_callback, METH_VARARGS, NULL},
+    {"freelist_stats", (PyCFunction)freelist_stats, METH_NOARGS, NULL},
+    {"set_freelist_size", (PyCFunction)set_freelist_size, METH_VARARGS, NULL},
     {NULL, NULL},
 };
 
@@ -213,14 +310,37 @@ init_libevent(void)
     if (PyType_Ready(&PyConfig_Type) < 0)
         return;
 
-    PyEvent_Type.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&PyCommonTimeout_Type) < 0)
+        return;
+
+    if (PyType_Ready(&PyHistogram_Type) < 0)
+        return;
+
+    if (PyType_Ready(&PyTimerWheel_Type) < 0)
+        return;
+
     if (PyType_Ready(&PyEvent_Type) < 0)
         return;
 
-    PyEventBuffer_Type.tp_new = PyType_GenericNew;
+    PyTimer_Type.tp_base = &PyEvent_Type;
+    if (PyType_Ready(&PyTimer_Type) < 0)
+        return;
+
+    PyPeriodicTimer_Type.tp_base = &PyEvent_Type;
+    PyPeriodicTimer_Type.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&PyPeriodicTimer_Type) < 0)
+        return;
+
+    PySignal_Type.tp_base = &PyEvent_Type;
+    if (PyType_Ready(&PySignal_Type) < 0)
+        return;
+
     if (PyType_Ready(&PyEventBuffer_Type) < 0)
         return;
 
+    if (PyType_Ready(&PyBufferSegment_Type) < 0)
+        return;
+
     PyBufferEvent_Type.tp_new = PyType_GenericNew;
     if (PyType_Ready(&PyBufferEvent_Type) < 0)
         return;
@@ -241,7 +361,6 @@ init_libevent(void)
     if (PyType_Ready(&PyHttpCallback_Type) < 0)
         return;
 
-    PyHttpRequest_Type.tp_new = PyType_GenericNew;
     if (PyType_Ready(&PyHttpRequest_Type) < 0)
         return;
 
@@ -272,8 +391,20 @@ init_libevent(void)
     PyModule_AddObject(m, "Base", (PyObject *)&PyEventBase_Type);
     Py_INCREF(&PyConfig_Type);
     PyModule_AddObject(m, "Config", (PyObject *)&PyConfig_Type);
+    Py_INCREF(&PyCommonTimeout_Type);
+    PyModule_AddObject(m, "CommonTimeout", (PyObject *)&PyCommonTimeout_Type);
+    Py_INCREF(&PyHistogram_Type);
+    PyModule_AddObject(m, "Histogram", (PyObject *)&PyHistogram_Type);
+    Py_INCREF(&PyTimerWheel_Type);
+    PyModule_AddObject(m, "TimerWheel", (PyObject *)&PyTimerWheel_Type);
     Py_INCREF(&PyEvent_Type);
     PyModule_AddObject(m, "Event", (PyObject *)&PyEvent_Type);
+    Py_INCREF(&PyTimer_Type);
+    PyModule_AddObject(m, "Timer", (PyObject *)&PyTimer_Type);
+    Py_INCREF(&PyPeriodicTimer_Type);
+    PyModule_AddObject(m, "PeriodicTimer", (PyObject *)&PyPeriodicTimer_Type);
+    Py_INCREF(&PySignal_Type);
+    PyModule_AddObject(m, "Signal", (PyObject *)&PySignal_Type);
     Py_INCREF(&PyEventBuffer_Type);
     PyModule_AddObject(m, "Buffer", (PyObject *)&PyEventBuffer_Type);
     Py_INCREF(&PyBufferEvent_Type);
@@ -289,6 +420,11 @@ init_libevent(void)
     Py_INCREF(&PyListener_Type);
     PyModule_AddObject(m, "Listener", (PyObject *)&PyListener_Type);
 
+    // policies of PeriodicTimer
+    PyModule_AddIntMacro(m, PERIODIC_SKIP);
+    PyModule_AddIntMacro(m, PERIODIC_COALESCE);
+    PyModule_AddIntMacro(m, PERIODIC_CATCH_UP);
+
     // event.h flags
     PyModule_AddIntMacro(m, EV_FEATURE_ET);
     PyModule_AddIntMacro(m, EV_FEATURE_O1);
@@ -373,4 +509,11 @@ init_libevent(void)
     PyModule_AddIntMacro(m, LEV_OPT_CLOSE_ON_EXEC);
     PyModule_AddIntMacro(m, LEV_OPT_REUSEABLE);
     PyModule_AddIntMacro(m, LEV_OPT_THREADSAFE);
+#if defined(LEV_OPT_REUSEABLE_PORT)
+    PyModule_AddIntMacro(m, LEV_OPT_REUSEABLE_PORT);
+#endif
+#if defined(SO_REUSEPORT)
+    // not provided by the socket module of Python 2
+    PyModule_AddIntMacro(m, SO_REUSEPORT);
+#endif
 }
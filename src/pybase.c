@@ -20,11 +20,22 @@
 
 #include <Python.h>
 #include <structmember.h>
+#if defined(WITH_THREAD)
+#include <pythread.h>
+#endif
 
 #include <event2/event.h>
 #include <event2/util.h>
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #include "pybase.h"
+#include "pyevent.h"
+#include "pyhistogram.h"
 
 #ifdef WIN32
   #define suseconds_t long
@@ -33,8 +44,48 @@
 typedef struct _PyConfigObject {
     PyObject_HEAD
     struct event_config *config;
+    int flags;
 } PyConfigObject;
 
+// Callback scheduled by Base.once, linked into the pending list of its base
+struct pybase_once {
+    struct pybase_once *prev;
+    struct pybase_once *next;
+    PyEventBaseObject *base;
+    PyObject *callback;
+    PyObject *userdata;
+};
+
+// Callback submitted by call_soon_threadsafe
+struct pybase_pending {
+    struct pybase_pending *next;
+    PyObject *callback;
+    PyObject *args;
+};
+
+#if defined(WIN32)
+#define pybase_compare_and_swap(ptr, old, new) \
+    (InterlockedCompareExchangePointer((PVOID volatile *) (ptr), (new), (old)) == (old))
+#define pybase_atomic_set(ptr, value) \
+    InterlockedExchange((LONG volatile *) (ptr), (value))
+#define pybase_atomic_get(ptr) \
+    InterlockedCompareExchange((LONG volatile *) (ptr), 0, 0)
+#else
+#define pybase_compare_and_swap(ptr, old, new) \
+    __sync_bool_compare_and_swap((ptr), (old), (new))
+#define pybase_atomic_set(ptr, value) \
+    do { __sync_lock_test_and_set((ptr), (value)); __sync_synchronize(); } while (0)
+#define pybase_atomic_get(ptr) \
+    __sync_fetch_and_add((ptr), 0)
+#endif
+
+typedef struct _PyCommonTimeoutObject {
+    PyObject_HEAD
+    PyEventBaseObject *base;
+    const struct timeval *tv;
+    double duration;
+} PyCommonTimeoutObject;
+
 void
 timeval_init(struct timeval *tv, double time)
 {
@@ -42,10 +93,117 @@ timeval_init(struct timeval *tv, double time)
     tv->tv_usec = (suseconds_t) ((time - tv->tv_sec) * 1000000);
 }
 
+double
+pybase_monotonic(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+int
+pybase_get_timeout(PyEventBaseObject *self, PyObject *timeout, struct timeval *tv, const struct timeval **result)
+{
+    double duration;
+
+    if (timeout == NULL || timeout == Py_None) {
+        *result = NULL;
+        return 0;
+    }
+    
+    if (PyCommonTimeout_Check(timeout)) {
+        if (((PyCommonTimeoutObject *) timeout)->base != self) {
+            PyErr_SetString(PyExc_TypeError, "the common timeout belongs to a different base");
+            return -1;
+        }
+        // Also provide the real duration, the common timeout is encoded
+        timeval_init(tv, ((PyCommonTimeoutObject *) timeout)->duration);
+        *result = ((PyCommonTimeoutObject *) timeout)->tv;
+        return 0;
+    }
+    
+    duration = PyFloat_AsDouble(timeout);
+    if (duration == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    
+    if (duration <= 0) {
+        *result = NULL;
+    } else {
+        timeval_init(tv, duration);
+        *result = tv;
+    }
+    return 0;
+}
+
+// Return a new object of the given type, taken from the freelist if
+// possible. The object is initialized like by tp_alloc.
+PyObject *
+pyfreelist_alloc(PyFreeList *list, PyTypeObject *type)
+{
+    PyObject *op = list->head;
+    if (op == NULL) {
+        list->misses++;
+        return type->tp_alloc(type, 0);
+    }
+    
+    list->head = (PyObject *) Py_TYPE(op);
+    list->size--;
+    list->hits++;
+    memset(op, 0, type->tp_basicsize);
+    (void) PyObject_INIT(op, type);
+    if (PyType_IS_GC(type)) {
+        PyObject_GC_Track(op);
+    }
+    return op;
+}
+
+// Keep a deallocated object for reuse, returns 0 if the freelist is full
+// and the object must be freed by the caller.
+int
+pyfreelist_release(PyFreeList *list, PyObject *op)
+{
+    if (list->size >= list->max_size) {
+        return 0;
+    }
+    
+    if (PyType_IS_GC(Py_TYPE(op))) {
+        PyObject_GC_UnTrack(op);
+    }
+    Py_TYPE(op) = (PyTypeObject *) list->head;
+    list->head = op;
+    list->size++;
+    return 1;
+}
+
+void
+pyfreelist_resize(PyFreeList *list, int max_size)
+{
+    list->max_size = max_size;
+    while (list->size > max_size) {
+        PyObject *op = list->head;
+        list->head = (PyObject *) Py_TYPE(op);
+        list->size--;
+        list->type->tp_free(op);
+    }
+}
+
 void
 pybase_store_error(PyEventBaseObject *self)
 {
-    if (self->error_type == NULL) {
+    self->stats.errors++;
+    if (self->error_type != NULL) {
+        // Only the first error is raised from the loop
+        PyErr_Clear();
+    } else {
         // Store exception for later reuse and signal loop to stop
         PyErr_Fetch(&self->error_type, &self->error_value, &self->error_traceback);
         Py_BEGIN_ALLOW_THREADS
@@ -54,6 +212,359 @@ pybase_store_error(PyEventBaseObject *self)
     }
 }
 
+// Build a descriptive name like "module.Class.method" for a callback
+static PyObject *
+pybase_callback_name(PyObject *callback)
+{
+    PyObject *func = callback;
+    PyObject *cls = NULL;
+    if (PyMethod_Check(callback)) {
+        func = PyMethod_GET_FUNCTION(callback);
+        cls = PyMethod_GET_CLASS(callback);
+    }
+    
+    if (PyFunction_Check(func)) {
+        PyFunctionObject *f = (PyFunctionObject *) func;
+        const char *module = "?";
+        if (f->func_module != NULL && PyString_Check(f->func_module)) {
+            module = PyString_AS_STRING(f->func_module);
+        }
+        if (cls != NULL && PyClass_Check(cls)) {
+            return PyString_FromFormat("%s.%s.%s", module,
+                PyString_AS_STRING(((PyClassObject *) cls)->cl_name),
+                PyString_AS_STRING(f->func_name));
+        } else if (cls != NULL && PyType_Check(cls)) {
+            return PyString_FromFormat("%s.%s.%s", module,
+                ((PyTypeObject *) cls)->tp_name, PyString_AS_STRING(f->func_name));
+        }
+        return PyString_FromFormat("%s.%s", module, PyString_AS_STRING(f->func_name));
+    }
+    
+    if (PyCFunction_Check(func)) {
+        return PyString_FromString(((PyCFunctionObject *) func)->m_ml->ml_name);
+    }
+    
+    if (PyInstance_Check(func)) {
+        return PyString_FromString(PyString_AS_STRING(((PyInstanceObject *) func)->in_class->cl_name));
+    }
+    return PyString_FromString(Py_TYPE(func)->tp_name);
+}
+
+// Record the duration of a callback and report it if it was too slow,
+// a pending exception of the callback is preserved.
+static void
+pybase_profile_callback(PyEventBaseObject *self, PyObject *callback, double duration)
+{
+    PyObject *error_type, *error_value, *error_traceback;
+    PyObject *histograms = self->callback_histograms;
+    PyObject *name;
+    PyObject *histogram;
+    
+    PyErr_Fetch(&error_type, &error_value, &error_traceback);
+    name = pybase_callback_name(callback);
+    if (name == NULL) {
+        PyErr_Print();
+        goto done;
+    }
+    
+    Py_INCREF(histograms);
+    histogram = PyDict_GetItem(histograms, name);
+    if (histogram == NULL) {
+        histogram = (PyObject *) pyhistogram_new();
+        if (histogram == NULL || PyDict_SetItem(histograms, name, histogram) < 0) {
+            Py_XDECREF(histogram);
+            Py_DECREF(histograms);
+            Py_DECREF(name);
+            PyErr_Print();
+            goto done;
+        }
+        Py_DECREF(histogram);
+    }
+    pyhistogram_record((PyHistogramObject *) histogram, (unsigned PY_LONG_LONG) (duration * 1000000.0));
+    Py_DECREF(histograms);
+    
+    if (self->slow_threshold > 0 && duration >= self->slow_threshold) {
+        self->slow_callbacks++;
+        if (self->slow_hook != NULL) {
+            PyObject *hook = self->slow_hook;
+            PyObject *result;
+            Py_INCREF(hook);
+            result = PyObject_CallFunction(hook, "OOd", callback, name, duration);
+            Py_DECREF(hook);
+            if (result == NULL) {
+                PyErr_Print();
+            } else {
+                Py_DECREF(result);
+            }
+        } else {
+            char msg[256];
+            PyOS_snprintf(msg, sizeof(msg), "slow callback %.200s took %.3f seconds",
+                PyString_AS_STRING(name), duration);
+            pylog_message(EVENT_LOG_WARN, msg);
+        }
+    }
+    Py_DECREF(name);
+    
+done:
+    PyErr_Restore(error_type, error_value, error_traceback);
+}
+
+// Stop the loop if the budget of run_for() is used up, the remaining
+// active events are processed by the next loop invocation.
+static void
+pybase_check_budget(PyEventBaseObject *self)
+{
+    if ((self->budget_callbacks > 0 && --self->budget_callbacks == 0) ||
+        (self->budget_deadline > 0 && pybase_monotonic() >= self->budget_deadline)) {
+        self->budget_active = 0;
+        Py_BEGIN_ALLOW_THREADS
+        event_base_loopbreak(self->base);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+// Invoke a callback with an argument tuple and account for it in the
+// statistics of the base.
+static PyObject *
+pybase_call_args(PyEventBaseObject *self, int kind, PyObject *callback, PyObject *args)
+{
+    PyObject *result;
+    double start;
+    double duration;
+
+    self->stats.callbacks[kind]++;
+    if (self->stats_timing || self->profile_callbacks) {
+        start = pybase_monotonic();
+        result = PyObject_Call(callback, args, NULL);
+        duration = pybase_monotonic() - start;
+        self->stats.callback_time += duration;
+        if (self->profile_callbacks) {
+            pybase_profile_callback(self, callback, duration);
+        }
+    } else {
+        result = PyObject_Call(callback, args, NULL);
+    }
+    if (self->budget_active) {
+        pybase_check_budget(self);
+    }
+    return result;
+}
+
+PyObject *
+pybase_call(PyEventBaseObject *self, int kind, PyObject *callback, PyObject **argcache, Py_ssize_t nargs, PyObject **argv)
+{
+    PyObject *args = NULL;
+    PyObject *result;
+    Py_ssize_t i;
+
+    // Take the cached argument tuple, so a reentrant call can't reuse it
+    if (argcache != NULL) {
+        args = *argcache;
+        *argcache = NULL;
+    }
+    if (args != NULL) {
+        PyObject_GC_Track(args);
+    } else {
+        args = PyTuple_New(nargs);
+        if (args == NULL) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < nargs; i++) {
+        Py_INCREF(argv[i]);
+        PyTuple_SET_ITEM(args, i, argv[i]);
+    }
+
+    // The callback might be replaced while it runs, e.g. by another thread
+    // or by itself through BufferEvent.set_callbacks
+    Py_INCREF(callback);
+    result = pybase_call_args(self, kind, callback, args);
+    Py_DECREF(callback);
+
+    if (argcache != NULL && *argcache == NULL && Py_REFCNT(args) == 1) {
+        // Nobody kept a reference to the tuple, so it can be recycled. The
+        // cache owner might go away while the arguments are released. The
+        // garbage collector must not see the empty slots while it's cached.
+        PyObject_GC_UnTrack(args);
+        Py_INCREF(args);
+        *argcache = args;
+        for (i = 0; i < nargs; i++) {
+            PyObject *tmp = PyTuple_GET_ITEM(args, i);
+            PyTuple_SET_ITEM(args, i, NULL);
+            Py_DECREF(tmp);
+        }
+    }
+    Py_DECREF(args);
+    return result;
+}
+
+#if defined(WITH_THREAD)
+int
+pybase_block_threads(PyEventBaseObject *self, PyGILState_STATE *state)
+{
+    double start;
+    if (self->looping && self->loop_thread == PyThread_get_thread_ident()) {
+        if (self->loop_tstate != NULL) {
+            // Resume the thread state of the loop. Unlike the one returned
+            // by PyGILState_Ensure, it belongs to the interpreter that runs
+            // the loop, which might be a sub-interpreter.
+            if (self->stats_timing) {
+                start = pybase_monotonic();
+                PyEval_RestoreThread(self->loop_tstate);
+                self->stats.gil_wait_time += pybase_monotonic() - start;
+            } else {
+                PyEval_RestoreThread(self->loop_tstate);
+            }
+            self->loop_tstate = NULL;
+            if (!self->batch_gil) {
+                return PYBASE_GIL_LOOP;
+            }
+            
+            // First callback of this loop iteration, keep the GIL until the
+            // loop is about to wait for events again.
+            self->gil_batches++;
+            return PYBASE_GIL_BATCHED;
+        }
+        
+        if (self->batch_gil && PyThreadState_GET() == self->loop_owner) {
+            // GIL is still held from a previous callback
+            self->gil_handoffs_saved++;
+            return PYBASE_GIL_BATCHED;
+        }
+    }
+    
+    if (self->stats_timing) {
+        start = pybase_monotonic();
+        *state = PyGILState_Ensure();
+        self->stats.gil_wait_time += pybase_monotonic() - start;
+    } else {
+        *state = PyGILState_Ensure();
+    }
+    return PYBASE_GIL_STATE;
+}
+#endif
+
+static unsigned PY_LONG_LONG
+pybase_total_callbacks(PyEventBaseObject *self)
+{
+    unsigned PY_LONG_LONG result = 0;
+    int i;
+    for (i = 0; i < PYBASE_CB_COUNT; i++) {
+        result += self->stats.callbacks[i];
+    }
+    return result;
+}
+
+// Adapt the spin window to the average time between loop iterations
+// that had work to do.
+static void
+pybase_busy_arrival(PyEventBaseObject *self, double now)
+{
+    double gap;
+    if (self->busy_last_arrival > 0) {
+        gap = now - self->busy_last_arrival;
+        if (self->busy_interarrival > 0) {
+            self->busy_interarrival = self->busy_interarrival * 0.875 + gap * 0.125;
+        } else {
+            self->busy_interarrival = gap;
+        }
+        if (self->busy_adaptive) {
+            if (self->busy_interarrival > self->busy_max_window) {
+                // Events are too rare, spinning would only burn the core
+                self->busy_window = 0;
+            } else if (self->busy_interarrival * 2 < self->busy_max_window) {
+                self->busy_window = self->busy_interarrival * 2;
+            } else {
+                self->busy_window = self->busy_max_window;
+            }
+        }
+    }
+    self->busy_last_arrival = now;
+}
+
+// Run one loop iteration, polling without blocking for the spin window
+// before waiting for events. Called without the GIL.
+static int
+pybase_busy_poll(PyEventBaseObject *self, int flags)
+{
+    unsigned PY_LONG_LONG callbacks = pybase_total_callbacks(self);
+    double start = pybase_monotonic();
+    double now = start;
+    int result;
+    while (now - start < self->busy_window) {
+        result = event_base_loop(self->base, flags|EVLOOP_NONBLOCK);
+        now = pybase_monotonic();
+        if (pybase_total_callbacks(self) != callbacks) {
+            self->spin_hits++;
+            pybase_busy_arrival(self, now);
+            return result;
+        }
+        if (result != 0 || pybase_atomic_get(&self->loopbreak) || self->error_type != NULL ||
+            event_base_got_exit(self->base) || event_base_got_break(self->base)) {
+            return result;
+        }
+    }
+    
+    self->spin_misses++;
+    result = event_base_loop(self->base, flags|EVLOOP_ONCE);
+    if (pybase_total_callbacks(self) != callbacks) {
+        pybase_busy_arrival(self, pybase_monotonic());
+    }
+    return result;
+}
+
+static int
+pybase_run_loop(PyEventBaseObject *self, int flags)
+{
+    int result;
+    int once = flags & (EVLOOP_ONCE|EVLOOP_NONBLOCK);
+    
+    if (self->looping) {
+        // Reentrant invocation, will be rejected by libevent
+        Py_BEGIN_ALLOW_THREADS
+        result = event_base_loop(self->base, flags);
+        Py_END_ALLOW_THREADS
+        return result;
+    }
+
+    // Run the loop one iteration at a time, so the iterations can be
+    // counted and the GIL kept by batched callbacks can be released
+    // before waiting for events again. libevent forgets a loopbreak() at
+    // the start of each iteration, so the flag of the base is checked
+    // after every one of them instead.
+    self->looping = 1;
+    pybase_atomic_set(&self->loopbreak, 0);
+#if defined(WITH_THREAD)
+    self->loop_thread = PyThread_get_thread_ident();
+#endif
+    self->loop_owner = PyThreadState_GET();
+    self->loop_tstate = PyEval_SaveThread();
+    while (1) {
+        if (self->loop_tstate == NULL) {
+            self->loop_tstate = PyEval_SaveThread();
+        }
+        if (!once && self->busy_max_window > 0) {
+            result = pybase_busy_poll(self, flags);
+        } else {
+            result = event_base_loop(self->base, once ? flags : flags|EVLOOP_ONCE);
+        }
+        self->stats.loop_iterations++;
+        if (result != 0 || once || pybase_atomic_get(&self->loopbreak) ||
+            self->error_type != NULL ||
+            event_base_got_exit(self->base) || event_base_got_break(self->base)) {
+            break;
+        }
+    }
+    if (self->loop_tstate != NULL) {
+        PyEval_RestoreThread(self->loop_tstate);
+        self->loop_tstate = NULL;
+    }
+    self->loop_owner = NULL;
+    self->looping = 0;
+    return result;
+}
+
 static PyObject *
 pybase_evalute_error_response(PyEventBaseObject *self)
 {
@@ -81,10 +592,137 @@ pybase_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         s->error_type = NULL;
         s->error_value = NULL;
         s->error_traceback = NULL;
+        s->batch_gil = 0;
+        s->threadsafe_bufferevents = 0;
+        s->looping = 0;
+        s->loopbreak = 0;
+        s->loop_thread = 0;
+        s->loop_tstate = NULL;
+        s->loop_owner = NULL;
+        s->gil_batches = 0;
+        s->gil_handoffs_saved = 0;
+        s->stats_timing = 0;
+        memset(&s->stats, 0, sizeof(s->stats));
+        s->profile_callbacks = 0;
+        s->slow_threshold = 0;
+        s->slow_hook = NULL;
+        s->callback_histograms = NULL;
+        s->slow_callbacks = 0;
+        s->timer_lag = NULL;
+        s->wakeup = NULL;
+        s->pending = NULL;
+        s->deferred = NULL;
+        s->onces = NULL;
+        s->budget_active = 0;
+        s->budget_callbacks = 0;
+        s->budget_deadline = 0;
+        s->budget_timer = NULL;
+        s->busy_max_window = 0;
+        s->busy_window = 0;
+        s->busy_adaptive = 0;
+        s->busy_last_arrival = 0;
+        s->busy_interarrival = 0;
+        s->spin_hits = 0;
+        s->spin_misses = 0;
     }
     return (PyObject *)s;
 }
 
+// Remove all pending callbacks, the oldest one is returned first
+static struct pybase_pending *
+pybase_take_pending(PyEventBaseObject *self)
+{
+    struct pybase_pending *head;
+    struct pybase_pending *prev = NULL;
+    do {
+        head = self->pending;
+    } while (!pybase_compare_and_swap(&self->pending, head, NULL));
+    
+    // The stack has the newest entry first
+    while (head != NULL) {
+        struct pybase_pending *next = head->next;
+        head->next = prev;
+        prev = head;
+        head = next;
+    }
+    
+    // Deferred callbacks were queued before any of the stack
+    if (self->deferred != NULL) {
+        head = self->deferred;
+        while (head->next != NULL) {
+            head = head->next;
+        }
+        head->next = prev;
+        prev = self->deferred;
+        self->deferred = NULL;
+    }
+    return prev;
+}
+
+static void
+pybase_free_pending(struct pybase_pending *pending)
+{
+    Py_DECREF(pending->callback);
+    Py_DECREF(pending->args);
+    PyMem_Free(pending);
+}
+
+// Unlink a pending once callback and release its references.
+static void
+pybase_free_once(struct pybase_once *once)
+{
+    if (once->prev != NULL) {
+        once->prev->next = once->next;
+    } else {
+        once->base->onces = once->next;
+    }
+    if (once->next != NULL) {
+        once->next->prev = once->prev;
+    }
+    Py_XDECREF(once->callback);
+    Py_XDECREF(once->userdata);
+    PyMem_Free(once);
+}
+
+static void
+pybase_wakeup_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    PyEventBaseObject *self = (PyEventBaseObject *) userdata;
+    START_BASE_BLOCK_THREADS(self)
+    int budget_active = self->budget_active;
+    struct pybase_pending *pending = pybase_take_pending(self);
+    while (pending != NULL) {
+        struct pybase_pending *next = pending->next;
+        PyObject *result = pybase_call_args(self, PYBASE_CB_SOON, pending->callback, pending->args);
+        if (result == NULL) {
+            pybase_store_error(self);
+        } else {
+            Py_DECREF(result);
+        }
+        pybase_free_pending(pending);
+        pending = next;
+        if (pending != NULL && budget_active && !self->budget_active) {
+            // The budget of run_for() is used up, keep the remaining
+            // callbacks for the next loop invocation.
+            self->deferred = pending;
+            Py_BEGIN_ALLOW_THREADS
+            event_active(self->wakeup, 0, 0);
+            Py_END_ALLOW_THREADS
+            break;
+        }
+    }
+    END_BASE_BLOCK_THREADS(self)
+}
+
+static void
+pybase_budget_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    // Runs in the loop without the GIL, so this can't call into Python
+    PyEventBaseObject *self = (PyEventBaseObject *) userdata;
+    self->budget_active = 0;
+    event_base_loopbreak(self->base);
+}
+
 static int
 pybase_init(PyEventBaseObject *self, PyObject *args, PyObject *kwds)
 {
@@ -96,28 +734,99 @@ pybase_init(PyEventBaseObject *self, PyObject *args, PyObject *kwds)
         self->base = event_base_new();
     } else {
         self->base = event_base_new_with_config(cfg->config);
+        self->nolock = (cfg->flags & EVENT_BASE_FLAG_NOLOCK) != 0;
     }
     if (self->base == NULL) {
         PyErr_NoMemory();
         return -1;
     }
+    self->timer_lag = pyhistogram_new();
+    if (self->timer_lag == NULL) {
+        return -1;
+    }
+    self->wakeup = event_new(self->base, -1, 0, pybase_wakeup_callback, self);
+    self->budget_timer = evtimer_new(self->base, pybase_budget_callback, self);
+    if (self->wakeup == NULL || self->budget_timer == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
     self->method = PyString_FromString(event_base_get_method(self->base));
     self->features = event_base_get_features(self->base);
     return 0;
 }
 
+static int
+pybase_traverse(PyEventBaseObject *self, visitproc visit, void *arg)
+{
+    struct pybase_pending *pending;
+    struct pybase_once *once;
+    Py_VISIT(self->error_type);
+    Py_VISIT(self->error_value);
+    Py_VISIT(self->error_traceback);
+    Py_VISIT(self->slow_hook);
+    Py_VISIT(self->callback_histograms);
+    // Entries are only pushed and taken with the GIL held
+    for (pending = self->pending; pending != NULL; pending = pending->next) {
+        Py_VISIT(pending->callback);
+        Py_VISIT(pending->args);
+    }
+    for (pending = self->deferred; pending != NULL; pending = pending->next) {
+        Py_VISIT(pending->callback);
+        Py_VISIT(pending->args);
+    }
+    for (once = self->onces; once != NULL; once = once->next) {
+        Py_VISIT(once->callback);
+        Py_VISIT(once->userdata);
+    }
+    return 0;
+}
+
+static int
+pybase_clear(PyEventBaseObject *self)
+{
+    struct pybase_pending *pending = pybase_take_pending(self);
+    struct pybase_once *once;
+    while (pending != NULL) {
+        struct pybase_pending *next = pending->next;
+        pybase_free_pending(pending);
+        pending = next;
+    }
+    // libevent still refers to the entries of pending once events, so only
+    // their references are dropped here.
+    for (once = self->onces; once != NULL; once = once->next) {
+        Py_CLEAR(once->callback);
+        Py_CLEAR(once->userdata);
+    }
+    Py_CLEAR(self->error_type);
+    Py_CLEAR(self->error_value);
+    Py_CLEAR(self->error_traceback);
+    Py_CLEAR(self->slow_hook);
+    Py_CLEAR(self->callback_histograms);
+    return 0;
+}
+
 static void
 pybase_dealloc(PyEventBaseObject *self)
 {
-    Py_XDECREF(self->error_type);
-    Py_XDECREF(self->error_value);
-    Py_XDECREF(self->error_traceback);
-    Py_DECREF(self->method);
+    PyObject_GC_UnTrack(self);
+    pybase_clear(self);
+    Py_XDECREF(self->method);
+    Py_XDECREF(self->timer_lag);
+    if (self->wakeup != NULL) {
+        event_free(self->wakeup);
+    }
+    if (self->budget_timer != NULL) {
+        event_free(self->budget_timer);
+    }
     if (self->base != NULL) {
         Py_BEGIN_ALLOW_THREADS
         event_base_free(self->base);
         Py_END_ALLOW_THREADS
     }
+    // event_base_free drops pending once events without calling back
+    while (self->onces != NULL) {
+        pybase_free_once(self->onces);
+    }
     Py_TYPE(self)->tp_free(self);
 }
 
@@ -126,9 +835,14 @@ PyDoc_STRVAR(pybase_reinit_doc, "Reinitialized the event base after a fork.");
 static PyObject *
 pybase_reinit(PyEventBaseObject *self, PyObject *args)
 {
+    int result;
     Py_BEGIN_ALLOW_THREADS
-    event_reinit(self->base);
+    result = event_reinit(self->base);
     Py_END_ALLOW_THREADS
+    if (result != 0) {
+        PyErr_SetString(PyExc_TypeError, "could not reinitialize the base");
+        return NULL;
+    }
     Py_RETURN_NONE;
 }
 
@@ -137,9 +851,7 @@ PyDoc_STRVAR(pybase_dispatch_doc, "Threadsafe event dispatching loop.");
 static PyObject *
 pybase_dispatch(PyEventBaseObject *self, PyObject *args)
 {
-    Py_BEGIN_ALLOW_THREADS
-    event_base_dispatch(self->base);
-    Py_END_ALLOW_THREADS
+    pybase_run_loop(self, 0);
     return pybase_evalute_error_response(self);
 }
 
@@ -152,12 +864,70 @@ pybase_loop(PyEventBaseObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "|i", &flags))
         return NULL;
         
-    Py_BEGIN_ALLOW_THREADS
-    event_base_loop(self->base, flags);
-    Py_END_ALLOW_THREADS
+    pybase_run_loop(self, flags);
     return pybase_evalute_error_response(self);
 }
 
+PyDoc_STRVAR(pybase_run_for_doc, "Handle events until max_seconds passed or max_callbacks callbacks were run, remaining active events are kept for the next call. Returns the number of callbacks that were run.");
+
+static PyObject *
+pybase_run_for(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *max_seconds = Py_None;
+    long max_callbacks = 0;
+    int flags = 0;
+    unsigned PY_LONG_LONG callbacks;
+    struct timeval tv;
+    double duration = 0;
+    if (!PyArg_ParseTuple(args, "|Oli", &max_seconds, &max_callbacks, &flags))
+        return NULL;
+
+    if (max_callbacks < 0) {
+        PyErr_SetString(PyExc_TypeError, "max_callbacks must not be negative");
+        return NULL;
+    }
+
+    if (max_seconds != Py_None) {
+        duration = PyFloat_AsDouble(max_seconds);
+        if (duration == -1 && PyErr_Occurred())
+            return NULL;
+    }
+
+    if (self->looping) {
+        PyErr_SetString(PyExc_TypeError, "can't run a loop that is already running");
+        return NULL;
+    }
+
+    callbacks = pybase_total_callbacks(self);
+    self->budget_callbacks = max_callbacks;
+    self->budget_deadline = 0;
+    if (duration > 0) {
+        // The timer stops the loop while waiting for events, the deadline
+        // while callbacks are running.
+        self->budget_deadline = pybase_monotonic() + duration;
+        timeval_init(&tv, duration);
+        Py_BEGIN_ALLOW_THREADS
+        evtimer_add(self->budget_timer, &tv);
+        Py_END_ALLOW_THREADS
+    }
+    self->budget_active = (max_callbacks > 0 || duration > 0);
+
+    pybase_run_loop(self, flags);
+
+    self->budget_active = 0;
+    if (duration > 0) {
+        Py_BEGIN_ALLOW_THREADS
+        evtimer_del(self->budget_timer);
+        Py_END_ALLOW_THREADS
+    }
+    callbacks = pybase_total_callbacks(self) - callbacks;
+
+    if (self->error_type != NULL) {
+        return pybase_evalute_error_response(self);
+    }
+    return PyLong_FromUnsignedLongLong(callbacks);
+}
+
 PyDoc_STRVAR(pybase_loopexit_doc, "Exit the event loop after the specified time (threadsafe variant).");
 
 static PyObject *
@@ -169,9 +939,9 @@ pybase_loopexit(PyEventBaseObject *self, PyObject *args)
         return NULL;
 
     timeval_init(&tv, duration);
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!self->nolock)
     event_base_loopexit(self->base, &tv);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
@@ -180,9 +950,17 @@ PyDoc_STRVAR(pybase_loopbreak_doc, "Abort the active loop() immediately.");
 static PyObject *
 pybase_loopbreak(PyEventBaseObject *self, PyObject *args)
 {
-    Py_BEGIN_ALLOW_THREADS
+    pybase_atomic_set(&self->loopbreak, 1);
+    BEGIN_ALLOW_THREADS_IF(!self->nolock)
     event_base_loopbreak(self->base);
-    Py_END_ALLOW_THREADS
+#if defined(WITH_THREAD)
+    if (self->looping && self->loop_thread != PyThread_get_thread_ident()) {
+        // The break is lost if it lands between two iterations of the loop
+        // thread, the active wakeup event ends the next one in any case.
+        event_active(self->wakeup, 0, 0);
+    }
+#endif
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
@@ -192,9 +970,9 @@ static PyObject *
 pybase_got_exit(PyEventBaseObject *self, PyObject *args)
 {
     int result;
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!self->nolock)
     result = event_base_got_exit(self->base);
-    Py_END_ALLOW_THREADS;
+    END_ALLOW_THREADS_IF
     return PyBool_FromLong(result);
 }
 
@@ -204,9 +982,9 @@ static PyObject *
 pybase_got_break(PyEventBaseObject *self, PyObject *args)
 {
     int result;
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!self->nolock)
     result = event_base_got_break(self->base);
-    Py_END_ALLOW_THREADS;
+    END_ALLOW_THREADS_IF
     return PyBool_FromLong(result);
 }
 
@@ -225,16 +1003,429 @@ pybase_priority_init(PyEventBaseObject *self, PyObject *args)
     Py_RETURN_NONE;
 }
 
+PyDoc_STRVAR(pybase_set_gil_batching_doc, "Keep the GIL across all callbacks of a loop iteration and only release it while waiting for events. Not available on bases with threadsafe BufferEvents.");
+
+static PyObject *
+pybase_set_gil_batching(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *enabled;
+    int batch_gil;
+    if (!PyArg_ParseTuple(args, "O", &enabled))
+        return NULL;
+
+    if (self->looping) {
+        PyErr_SetString(PyExc_TypeError, "can't change GIL batching while the loop is running");
+        return NULL;
+    }
+
+    batch_gil = PyObject_IsTrue(enabled);
+    if (batch_gil < 0)
+        return NULL;
+
+    if (batch_gil && self->threadsafe_bufferevents > 0) {
+        // libevent takes the lock of a threadsafe bufferevent before its
+        // callbacks, while another thread might hold it and wait for the
+        // GIL kept by the batch.
+        PyErr_SetString(PyExc_TypeError, "can't batch the GIL with threadsafe BufferEvents on the base");
+        return NULL;
+    }
+    self->batch_gil = batch_gil;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_now_doc, "Return the wall clock time cached by the loop in seconds since the epoch, like time.time().");
+
+static PyObject *
+pybase_now(PyEventBaseObject *self, PyObject *args)
+{
+    struct timeval tv;
+    // Cheap enough to keep the GIL
+    if (event_base_gettimeofday_cached(self->base, &tv) != 0) {
+        PyErr_SetString(PyExc_TypeError, "could not get the time");
+        return NULL;
+    }
+    return PyFloat_FromDouble(tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+PyDoc_STRVAR(pybase_monotonic_doc, "Return the time of a monotonic clock in seconds.");
+
+static PyObject *
+pybase_monotonic_time(PyEventBaseObject *self, PyObject *args)
+{
+    return PyFloat_FromDouble(pybase_monotonic());
+}
+
+PyDoc_STRVAR(pybase_set_busy_poll_doc, "Poll for events without blocking for up to max_window seconds before waiting for them. If adaptive is true, the window follows the average time between events. A window of 0 disables busy polling.");
+
+static PyObject *
+pybase_set_busy_poll(PyEventBaseObject *self, PyObject *args)
+{
+    double max_window;
+    PyObject *adaptive = Py_True;
+    int value;
+    if (!PyArg_ParseTuple(args, "d|O", &max_window, &adaptive))
+        return NULL;
+
+    if (max_window < 0) {
+        PyErr_SetString(PyExc_TypeError, "the window can't be negative");
+        return NULL;
+    }
+
+    value = PyObject_IsTrue(adaptive);
+    if (value < 0)
+        return NULL;
+
+    if (self->looping) {
+        PyErr_SetString(PyExc_TypeError, "can't change busy polling while the loop is running");
+        return NULL;
+    }
+
+    self->busy_max_window = max_window;
+    self->busy_window = max_window;
+    self->busy_adaptive = value;
+    self->busy_last_arrival = 0;
+    self->busy_interarrival = 0;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_common_timeout_doc, "Prepare a timeout that is shared by a large number of events with the same duration.");
+
+static PyObject *
+pybase_common_timeout(PyEventBaseObject *self, PyObject *args)
+{
+    double duration;
+    struct timeval tv;
+    const struct timeval *common;
+    PyCommonTimeoutObject *result;
+    if (!PyArg_ParseTuple(args, "d", &duration))
+        return NULL;
+
+    if (duration <= 0) {
+        PyErr_Format(PyExc_TypeError, "can't create a common timeout for %f seconds", duration);
+        return NULL;
+    }
+
+    timeval_init(&tv, duration);
+    Py_BEGIN_ALLOW_THREADS
+    common = event_base_init_common_timeout(self->base, &tv);
+    Py_END_ALLOW_THREADS
+    if (common == NULL) {
+        PyErr_SetString(PyExc_TypeError, "could not create common timeout");
+        return NULL;
+    }
+
+    result = PyObject_New(PyCommonTimeoutObject, &PyCommonTimeout_Type);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    result->base = self;
+    Py_INCREF(self);
+    result->tv = common;
+    result->duration = duration;
+    return (PyObject *) result;
+}
+
+static void
+pybase_once_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    struct pybase_once *once = (struct pybase_once *) userdata;
+    PyEventBaseObject *base = once->base;
+    START_BASE_BLOCK_THREADS(base)
+    PyObject *pyfd = PyInt_FromLong(fd);
+    PyObject *pywhat = PyInt_FromLong(what);
+    PyObject *argv[3] = {pyfd, pywhat, once->userdata};
+    PyObject *result = NULL;
+    if (once->callback == NULL) {
+        // Cleared by the garbage collector
+        result = Py_None;
+        Py_INCREF(result);
+    } else if (pyfd != NULL && pywhat != NULL) {
+        result = pybase_call(base, PYBASE_CB_ONCE, once->callback, NULL, 3, argv);
+    }
+    Py_XDECREF(pyfd);
+    Py_XDECREF(pywhat);
+    if (result == NULL) {
+        pybase_store_error(base);
+    } else {
+        Py_DECREF(result);
+    }
+    pybase_free_once(once);
+    END_BASE_BLOCK_THREADS(base)
+}
+
+PyDoc_STRVAR(pybase_once_doc, "Schedule a one-time callback without creating an event object.");
+
+static PyObject *
+pybase_once(PyEventBaseObject *self, PyObject *args)
+{
+    int fd;
+    int what;
+    PyObject *callback;
+    PyObject *timeout=Py_None;
+    PyObject *userdata=Py_None;
+    struct timeval tv;
+    const struct timeval *ptv;
+    struct pybase_once *once;
+    int result;
+    if (!PyArg_ParseTuple(args, "iiO|OO", &fd, &what, &callback, &timeout, &userdata))
+        return NULL;
+
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "the callback must be callable");
+        return NULL;
+    }
+
+    if (pybase_get_timeout(self, timeout, &tv, &ptv) != 0)
+        return NULL;
+
+    once = (struct pybase_once *) PyMem_Malloc(sizeof(struct pybase_once));
+    if (once == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    // The base is not referenced, it releases the callbacks still pending
+    // when it is freed.
+    once->prev = NULL;
+    once->next = self->onces;
+    if (once->next != NULL) {
+        once->next->prev = once;
+    }
+    self->onces = once;
+    once->base = self;
+    once->callback = callback;
+    Py_INCREF(callback);
+    once->userdata = userdata;
+    Py_INCREF(userdata);
+    Py_BEGIN_ALLOW_THREADS
+    result = event_base_once(self->base, fd, what, pybase_once_callback, once, ptv);
+    Py_END_ALLOW_THREADS
+    if (result != 0) {
+        pybase_free_once(once);
+        PyErr_SetString(PyExc_TypeError, "could not schedule callback");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_call_soon_threadsafe_doc, "Run callback(*args) from the loop of the base, may be called from any thread.");
+
+static PyObject *
+pybase_call_soon_threadsafe(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *callback;
+    struct pybase_pending *pending;
+    struct pybase_pending *head;
+    if (PyTuple_GET_SIZE(args) < 1) {
+        PyErr_SetString(PyExc_TypeError, "call_soon_threadsafe() requires a callback");
+        return NULL;
+    }
+
+    callback = PyTuple_GET_ITEM(args, 0);
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "the callback must be callable");
+        return NULL;
+    }
+
+    pending = (struct pybase_pending *) PyMem_Malloc(sizeof(struct pybase_pending));
+    if (pending == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    pending->args = PyTuple_GetSlice(args, 1, PyTuple_GET_SIZE(args));
+    if (pending->args == NULL) {
+        PyMem_Free(pending);
+        return NULL;
+    }
+    pending->callback = callback;
+    Py_INCREF(callback);
+    
+    do {
+        head = self->pending;
+        pending->next = head;
+    } while (!pybase_compare_and_swap(&self->pending, head, pending));
+    
+    if (head == NULL) {
+        // Only the first callback of a burst needs to wake up the loop,
+        // the others are run by the same activation.
+        Py_BEGIN_ALLOW_THREADS
+        event_active(self->wakeup, 0, 0);
+        Py_END_ALLOW_THREADS
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_activate_many_doc, "Make all events of a sequence active with the given flags.");
+
+static PyObject *
+pybase_activate_many(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *sequence;
+    PyObject *events;
+    int what;
+    Py_ssize_t i;
+    Py_ssize_t count;
+    if (!PyArg_ParseTuple(args, "Oi", &sequence, &what))
+        return NULL;
+
+    // Keep the events alive while the GIL is released
+    events = PySequence_Tuple(sequence);
+    if (events == NULL)
+        return NULL;
+
+    count = PyTuple_GET_SIZE(events);
+    for (i = 0; i < count; i++) {
+        PyObject *event = PyTuple_GET_ITEM(events, i);
+        if (!PyEvent_Check(event)) {
+            PyErr_Format(PyExc_TypeError, "expected an Event, not %s", event->ob_type->tp_name);
+            Py_DECREF(events);
+            return NULL;
+        }
+        if (((PyEventObject *) event)->base != self) {
+            PyErr_SetString(PyExc_TypeError, "the event belongs to a different base");
+            Py_DECREF(events);
+            return NULL;
+        }
+    }
+
+    // libevent doesn't export the lock of the base, so the events are
+    // activated one by one, but with a single release of the GIL.
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < count; i++) {
+        event_active(((PyEventObject *) PyTuple_GET_ITEM(events, i))->event, what, 1);
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(events);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_stats_doc, "Return the loop statistics of the base.");
+
+static PyObject *
+pybase_stats(PyEventBaseObject *self, PyObject *args)
+{
+    PyEventBaseStats *stats = &self->stats;
+    return Py_BuildValue("{sKsKsKsKsKsKsKsKsKsKsKsdsdsksksksksksd}",
+        "loop_iterations", stats->loop_iterations,
+        "event_callbacks", stats->callbacks[PYBASE_CB_EVENT],
+        "once_callbacks", stats->callbacks[PYBASE_CB_ONCE],
+        "bufferevent_read_callbacks", stats->callbacks[PYBASE_CB_BUFFEREVENT_READ],
+        "bufferevent_write_callbacks", stats->callbacks[PYBASE_CB_BUFFEREVENT_WRITE],
+        "bufferevent_event_callbacks", stats->callbacks[PYBASE_CB_BUFFEREVENT_EVENT],
+        "listener_callbacks", stats->callbacks[PYBASE_CB_LISTENER],
+        "http_callbacks", stats->callbacks[PYBASE_CB_HTTP],
+        "soon_callbacks", stats->callbacks[PYBASE_CB_SOON],
+        "timerwheel_callbacks", stats->callbacks[PYBASE_CB_TIMERWHEEL],
+        "errors", stats->errors,
+        "callback_time", stats->callback_time,
+        "gil_wait_time", stats->gil_wait_time,
+        "gil_batches", self->gil_batches,
+        "gil_handoffs_saved", self->gil_handoffs_saved,
+        "slow_callbacks", self->slow_callbacks,
+        "spin_hits", self->spin_hits,
+        "spin_misses", self->spin_misses,
+        "busy_poll_window", self->busy_window);
+}
+
+PyDoc_STRVAR(pybase_set_stats_timing_doc, "Measure the time spent in callbacks and waiting for the GIL (adds clock reads to every callback).");
+
+static PyObject *
+pybase_set_stats_timing(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *enabled;
+    int value;
+    if (!PyArg_ParseTuple(args, "O", &enabled))
+        return NULL;
+
+    value = PyObject_IsTrue(enabled);
+    if (value < 0)
+        return NULL;
+    
+    self->stats_timing = value;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_set_callback_profiling_doc, "Time every callback and keep a histogram per callable in callback_histograms. Callbacks running for at least threshold seconds call hook(callback, name, duration) or are reported through the log callback. A threshold of None disables profiling.");
+
+static PyObject *
+pybase_set_callback_profiling(PyEventBaseObject *self, PyObject *args)
+{
+    PyObject *threshold;
+    PyObject *hook = NULL;
+    PyObject *tmp;
+    double value = 0;
+    if (!PyArg_ParseTuple(args, "O|O", &threshold, &hook))
+        return NULL;
+
+    if (threshold != Py_None) {
+        value = PyFloat_AsDouble(threshold);
+        if (value == -1 && PyErr_Occurred())
+            return NULL;
+    }
+    
+    if (hook == Py_None) {
+        hook = NULL;
+    } else if (hook != NULL && !PyCallable_Check(hook)) {
+        PyErr_Format(PyExc_TypeError, "expected a callable or None, not %s", hook->ob_type->tp_name);
+        return NULL;
+    }
+    
+    if (threshold != Py_None && self->callback_histograms == NULL) {
+        self->callback_histograms = PyDict_New();
+        if (self->callback_histograms == NULL)
+            return NULL;
+    }
+    
+    tmp = self->slow_hook;
+    Py_XINCREF(hook);
+    self->slow_hook = hook;
+    Py_XDECREF(tmp);
+    self->slow_threshold = value;
+    self->profile_callbacks = (threshold != Py_None);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pybase_reset_stats_doc, "Reset the loop statistics of the base.");
+
+static PyObject *
+pybase_reset_stats(PyEventBaseObject *self, PyObject *args)
+{
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->gil_batches = 0;
+    self->gil_handoffs_saved = 0;
+    self->slow_callbacks = 0;
+    self->spin_hits = 0;
+    self->spin_misses = 0;
+    if (self->callback_histograms != NULL) {
+        PyDict_Clear(self->callback_histograms);
+    }
+    pyhistogram_reset(self->timer_lag);
+    Py_RETURN_NONE;
+}
+
 static PyMethodDef
 pybase_methods[] = {
     {"reinit", (PyCFunction)pybase_reinit, METH_NOARGS, pybase_reinit_doc},
     {"dispatch", (PyCFunction)pybase_dispatch, METH_NOARGS, pybase_dispatch_doc},
+    {"run_for", (PyCFunction)pybase_run_for, METH_VARARGS, pybase_run_for_doc},
     {"loop", (PyCFunction)pybase_loop, METH_VARARGS, pybase_loop_doc},
     {"loopexit", (PyCFunction)pybase_loopexit, METH_VARARGS, pybase_loopexit_doc},
     {"loopbreak", (PyCFunction)pybase_loopbreak, METH_NOARGS, pybase_loopbreak_doc},
     {"got_exit", (PyCFunction)pybase_got_exit, METH_NOARGS, pybase_got_exit_doc},
     {"got_break", (PyCFunction)pybase_got_break, METH_NOARGS, pybase_got_break_doc},
     {"priority_init", (PyCFunction)pybase_priority_init, METH_VARARGS, pybase_priority_init_doc},
+    {"set_gil_batching", (PyCFunction)pybase_set_gil_batching, METH_VARARGS, pybase_set_gil_batching_doc},
+    {"now", (PyCFunction)pybase_now, METH_NOARGS, pybase_now_doc},
+    {"monotonic", (PyCFunction)pybase_monotonic_time, METH_NOARGS, pybase_monotonic_doc},
+    {"set_busy_poll", (PyCFunction)pybase_set_busy_poll, METH_VARARGS, pybase_set_busy_poll_doc},
+    {"common_timeout", (PyCFunction)pybase_common_timeout, METH_VARARGS, pybase_common_timeout_doc},
+    {"once", (PyCFunction)pybase_once, METH_VARARGS, pybase_once_doc},
+    {"call_soon_threadsafe", (PyCFunction)pybase_call_soon_threadsafe, METH_VARARGS, pybase_call_soon_threadsafe_doc},
+    {"activate_many", (PyCFunction)pybase_activate_many, METH_VARARGS, pybase_activate_many_doc},
+    {"stats", (PyCFunction)pybase_stats, METH_NOARGS, pybase_stats_doc},
+    {"set_stats_timing", (PyCFunction)pybase_set_stats_timing, METH_VARARGS, pybase_set_stats_timing_doc},
+    {"set_callback_profiling", (PyCFunction)pybase_set_callback_profiling, METH_VARARGS, pybase_set_callback_profiling_doc},
+    {"reset_stats", (PyCFunction)pybase_reset_stats, METH_NOARGS, pybase_reset_stats_doc},
     {NULL, NULL},
 };
 
@@ -242,6 +1433,12 @@ static PyMemberDef
 pybase_members[] = {
     {"method", T_OBJECT, offsetof(PyEventBaseObject, method), READONLY, "kernel event notification mechanism"},
     {"features", T_INT, offsetof(PyEventBaseObject, features), READONLY, "bitmask of the features implemented"},
+    {"nolock", T_INT, offsetof(PyEventBaseObject, nolock), READONLY, "created with EVENT_BASE_FLAG_NOLOCK, calls that can't block keep the GIL"},
+    {"gil_batches", T_ULONG, offsetof(PyEventBaseObject, gil_batches), READONLY, "number of loop iterations that acquired the GIL once for all callbacks"},
+    {"gil_handoffs_saved", T_ULONG, offsetof(PyEventBaseObject, gil_handoffs_saved), READONLY, "number of callbacks that didn't have to acquire the GIL"},
+    {"callback_histograms", T_OBJECT, offsetof(PyEventBaseObject, callback_histograms), READONLY, "histograms of callback durations by callable name"},
+    {"timer_lag", T_OBJECT, offsetof(PyEventBaseObject, timer_lag), READONLY, "histogram of the delay between the deadline and the callback of timeouts"},
+    {"slow_callbacks", T_ULONG, offsetof(PyEventBaseObject, slow_callbacks), READONLY, "number of callbacks that exceeded the profiling threshold"},
     {NULL}
 };
 
@@ -269,10 +1466,10 @@ PyEventBase_Type = {
     0,                    /* tp_getattro */
     0,                    /* tp_setattro */
     0,                    /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,   /* tp_flags */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC,   /* tp_flags */
     pybase_doc,           /* tp_doc */
-    0,                    /* tp_traverse */
-    0,                    /* tp_clear */
+    (traverseproc)pybase_traverse, /* tp_traverse */
+    (inquiry)pybase_clear, /* tp_clear */
     0,                    /* tp_richcompare */
     0,                    /* tp_weaklistoffset */
     0,                    /* tp_iter */
@@ -363,6 +1560,7 @@ pyconfig_set_flag(PyConfigObject *self, PyObject *args)
         return NULL;
         
     event_config_set_flag(self->config, flag);
+    self->flags |= flag;
     Py_RETURN_NONE;
 }
 
@@ -380,12 +1578,49 @@ pyconfig_set_num_cpus_hint(PyConfigObject *self, PyObject *args)
     Py_RETURN_NONE;
 }
 
+PyDoc_STRVAR(pyconfig_set_max_dispatch_interval_doc, "Check for higher-priority events after max_interval seconds or max_callbacks callbacks of priorities at least min_priority.");
+
+static PyObject *
+pyconfig_set_max_dispatch_interval(PyConfigObject *self, PyObject *args)
+{
+    PyObject *max_interval;
+    int max_callbacks;
+    int min_priority;
+    struct timeval tv;
+    struct timeval *ptv = NULL;
+    double interval;
+    
+    if (!PyArg_ParseTuple(args, "Oii", &max_interval, &max_callbacks, &min_priority))
+        return NULL;
+    
+    if (max_interval != Py_None) {
+        interval = PyFloat_AsDouble(max_interval);
+        if (interval == -1 && PyErr_Occurred())
+            return NULL;
+        
+        timeval_init(&tv, interval);
+        ptv = &tv;
+    }
+    
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    if (event_config_set_max_dispatch_interval(self->config, ptv, max_callbacks, min_priority) != 0) {
+        PyErr_SetString(PyExc_TypeError, "could not set the maximum dispatch interval");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+#else
+    PyErr_SetString(PyExc_TypeError, "the maximum dispatch interval requires libevent 2.1");
+    return NULL;
+#endif
+}
+
 static PyMethodDef
 pyconfig_methods[] = {
     {"avoid_method", (PyCFunction)pyconfig_avoid_method, METH_VARARGS, pyconfig_avoid_method_doc},
     {"require_features", (PyCFunction)pyconfig_require_features, METH_VARARGS, pyconfig_require_features_doc},
     {"set_flag", (PyCFunction)pyconfig_set_flag, METH_VARARGS, pyconfig_set_flag_doc},
     {"set_num_cpus_hint", (PyCFunction)pyconfig_set_num_cpus_hint, METH_VARARGS, pyconfig_set_num_cpus_hint_doc},
+    {"set_max_dispatch_interval", (PyCFunction)pyconfig_set_max_dispatch_interval, METH_VARARGS, pyconfig_set_max_dispatch_interval_doc},
     {NULL, NULL},
 };
 
@@ -434,3 +1669,63 @@ PyConfig_Type = {
     pyconfig_new,         /* tp_new */
     0,                    /* tp_free */
 };
+
+static void
+pycommon_timeout_dealloc(PyCommonTimeoutObject *self)
+{
+    Py_XDECREF(self->base);
+    PyObject_Del(self);
+}
+
+static PyMemberDef
+pycommon_timeout_members[] = {
+    {"base", T_OBJECT, offsetof(PyCommonTimeoutObject, base), READONLY, "the base this timeout is assigned to"},
+    {"duration", T_DOUBLE, offsetof(PyCommonTimeoutObject, duration), READONLY, "the duration of the timeout in seconds"},
+    {NULL}
+};
+
+PyDoc_STRVAR(pycommon_timeout_doc, "Common timeout");
+
+PyTypeObject
+PyCommonTimeout_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.CommonTimeout", /* tp_name */
+    sizeof(PyCommonTimeoutObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pycommon_timeout_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,   /* tp_flags */
+    pycommon_timeout_doc, /* tp_doc */
+    0,                    /* tp_traverse */
+    0,                    /* tp_clear */
+    0,                    /* tp_richcompare */
+    0,                    /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    0,                    /* tp_methods */
+    pycommon_timeout_members, /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    0,                    /* tp_init */
+    0,                    /* tp_alloc */
+    0,                    /* tp_new */
+    0,                    /* tp_free */
+};
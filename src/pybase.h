@@ -29,19 +29,80 @@
     PyGILState_STATE __savestate = PyGILState_Ensure();
 #define END_BLOCK_THREADS \
     PyGILState_Release(__savestate);
+// Variant for callbacks executed by the loop of a base, resumes the thread
+// state of the loop and may keep the GIL until the loop waits for events
+// again if GIL batching is enabled.
+#define START_BASE_BLOCK_THREADS(base) \
+    PyEventBaseObject *__base = (base); \
+    PyGILState_STATE __savestate; \
+    int __gil = pybase_block_threads(__base, &__savestate);
+#define END_BASE_BLOCK_THREADS(base) \
+    if (__gil == PYBASE_GIL_STATE) { \
+        PyGILState_Release(__savestate); \
+    } else if (__gil == PYBASE_GIL_LOOP) { \
+        __base->loop_tstate = PyEval_SaveThread(); \
+    }
+// Variant of Py_BEGIN_ALLOW_THREADS for calls that only take locks of
+// libevent, which don't exist on bases created with EVENT_BASE_FLAG_NOLOCK
+// and unlocked buffers. Handing off the GIL would cost more than the call.
+#define BEGIN_ALLOW_THREADS_IF(release) { \
+    PyThreadState *_save = (release) ? PyEval_SaveThread() : NULL;
+#define END_ALLOW_THREADS_IF \
+    if (_save != NULL) { PyEval_RestoreThread(_save); } }
 #else
 #define START_BLOCK_THREADS
 #define END_BLOCK_THREADS
+#define START_BASE_BLOCK_THREADS(base)
+#define END_BASE_BLOCK_THREADS(base)
+#define BEGIN_ALLOW_THREADS_IF(release) {
+#define END_ALLOW_THREADS_IF }
 #endif
 
 #if !defined(Py_TYPE)
 #define Py_TYPE(ob) (((PyObject*)(ob))->ob_type)
 #endif
 
+#if !defined(Py_REFCNT)
+#define Py_REFCNT(ob) (((PyObject*)(ob))->ob_refcnt)
+#endif
+
 #if !defined(PyLong_FromSsize_t)
 #define PyLong_FromSsize_t(v) PyLong_FromLong(v)
 #endif
 
+#if !defined(PY_LONG_LONG)
+#define PY_LONG_LONG long
+#endif
+
+// How a callback acquired the GIL, see pybase_block_threads
+enum {
+    PYBASE_GIL_STATE,
+    PYBASE_GIL_BATCHED,
+    PYBASE_GIL_LOOP,
+};
+
+// Types of callbacks counted in the statistics of a base
+enum {
+    PYBASE_CB_EVENT,
+    PYBASE_CB_ONCE,
+    PYBASE_CB_BUFFEREVENT_READ,
+    PYBASE_CB_BUFFEREVENT_WRITE,
+    PYBASE_CB_BUFFEREVENT_EVENT,
+    PYBASE_CB_LISTENER,
+    PYBASE_CB_HTTP,
+    PYBASE_CB_SOON,
+    PYBASE_CB_TIMERWHEEL,
+    PYBASE_CB_COUNT
+};
+
+typedef struct _PyEventBaseStats {
+    unsigned PY_LONG_LONG loop_iterations;
+    unsigned PY_LONG_LONG callbacks[PYBASE_CB_COUNT];
+    unsigned PY_LONG_LONG errors;
+    double callback_time;
+    double gil_wait_time;
+} PyEventBaseStats;
+
 typedef struct _PyEventBaseObject {
     PyObject_HEAD
     struct event_base *base;
@@ -50,14 +111,77 @@ typedef struct _PyEventBaseObject {
     PyObject *error_type;
     PyObject *error_value;
     PyObject *error_traceback;
+    int batch_gil;
+    // BufferEvents created with BEV_OPT_THREADSAFE, which rule out batching
+    int threadsafe_bufferevents;
+    int nolock;
+    int looping;
+    // Only accessed atomically, set by loopbreak() from any thread
+    volatile int loopbreak;
+    long loop_thread;
+    PyThreadState *loop_tstate;
+    PyThreadState *loop_owner;
+    unsigned long gil_batches;
+    unsigned long gil_handoffs_saved;
+    int stats_timing;
+    PyEventBaseStats stats;
+    int profile_callbacks;
+    double slow_threshold;
+    PyObject *slow_hook;
+    PyObject *callback_histograms;
+    unsigned long slow_callbacks;
+    struct _PyHistogramObject *timer_lag;
+    struct event *wakeup;
+    struct pybase_pending *volatile pending;
+    // Callbacks left over by the budget of run_for(), only used with the GIL
+    struct pybase_pending *deferred;
+    struct pybase_once *onces;
+    int budget_active;
+    unsigned long budget_callbacks;
+    double budget_deadline;
+    struct event *budget_timer;
+    double busy_max_window;
+    double busy_window;
+    int busy_adaptive;
+    double busy_last_arrival;
+    double busy_interarrival;
+    unsigned long spin_hits;
+    unsigned long spin_misses;
 } PyEventBaseObject;
 
+// Bounded list of deallocated wrapper objects that are reused for new
+// objects of the same size, linked through their type pointer.
+typedef struct _PyFreeList {
+    const char *name;
+    PyTypeObject *type;
+    PyObject *head;
+    int size;
+    int max_size;
+    unsigned long hits;
+    unsigned long misses;
+} PyFreeList;
+
+#define PYFREELIST_DEFAULT_SIZE 80
+#define PYFREELIST_INIT(name, type) {name, type, NULL, 0, PYFREELIST_DEFAULT_SIZE, 0, 0}
+
 extern PyTypeObject PyEventBase_Type;
 extern PyTypeObject PyConfig_Type;
+extern PyTypeObject PyCommonTimeout_Type;
 
 extern void timeval_init(struct timeval *tv, double time);
+extern double pybase_monotonic(void);
+extern int pybase_get_timeout(PyEventBaseObject *self, PyObject *timeout, struct timeval *tv, const struct timeval **result);
 extern void pybase_store_error(PyEventBaseObject *self);
+extern void pylog_message(int severity, const char *msg);
+#if defined(WITH_THREAD)
+extern int pybase_block_threads(PyEventBaseObject *self, PyGILState_STATE *state);
+#endif
+extern PyObject *pyfreelist_alloc(PyFreeList *list, PyTypeObject *type);
+extern int pyfreelist_release(PyFreeList *list, PyObject *op);
+extern void pyfreelist_resize(PyFreeList *list, int max_size);
+extern PyObject *pybase_call(PyEventBaseObject *self, int kind, PyObject *callback, PyObject **argcache, Py_ssize_t nargs, PyObject **argv);
 
 #define PyEventBase_Check(ob) ((ob)->ob_type == &PyEventBase_Type)
+#define PyCommonTimeout_Check(ob) ((ob)->ob_type == &PyCommonTimeout_Type)
 
 #endif
@@ -26,15 +26,26 @@
 #include "pybase.h"
 #include "pybuffer.h"
 
+// Subclasses are always allocated by their type.
+PyFreeList pybuffer_freelist = PYFREELIST_INIT("buffer", &PyEventBuffer_Type);
+
 static PyObject *
 pybuffer_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
     PyBufferObject *s;
-    s = (PyBufferObject *)type->tp_alloc(type, 0);
+    if (type == &PyEventBuffer_Type) {
+        s = (PyBufferObject *)pyfreelist_alloc(&pybuffer_freelist, type);
+    } else {
+        s = (PyBufferObject *)type->tp_alloc(type, 0);
+    }
     if (s != NULL) {
         s->buffer = NULL;
         s->base = NULL;
         s->owned = 0;
+        s->locked = 0;
+        s->exports = 0;
+        s->owner = NULL;
+        s->nreserved = 0;
     }
     return (PyObject *)s;
 }
@@ -42,7 +53,7 @@ pybuffer_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 PyBufferObject *
 _pybuffer_create(struct evbuffer *buffer)
 {
-    PyBufferObject *result = (PyBufferObject *)PyEventBuffer_Type.tp_alloc(&PyEventBuffer_Type, 0);
+    PyBufferObject *result = (PyBufferObject *)pyfreelist_alloc(&pybuffer_freelist, &PyEventBuffer_Type);
     if (result == NULL) {
         return NULL;
     }
@@ -50,12 +61,69 @@ _pybuffer_create(struct evbuffer *buffer)
     result->buffer = buffer;
     result->base = NULL;
     result->owned = 0;
+    // The owner of the buffer might have enabled locking
+    result->locked = 1;
+    result->exports = 0;
+    result->owner = NULL;
+    result->nreserved = 0;
     return result;
 }
 
+// Called by the owner before it frees the evbuffer.
+void
+_pybuffer_detach(PyBufferObject *self)
+{
+    self->buffer = NULL;
+    self->owner = NULL;
+    self->nreserved = 0;
+}
+
+PyObject *
+_pybuffer_exported_error(void)
+{
+    PyErr_SetString(PyExc_TypeError, "can't modify a buffer while views of it are exported");
+    return NULL;
+}
+
+// Lock two buffers to check their exports before libevent moves data
+// between them. libevent holds the lock of a bufferevent while it runs the
+// callbacks, which might modify other buffers, so the buffers of a
+// BufferEvent are always locked first, other buffers by their address.
+// Buffers of BufferEvents can't export views and are left to libevent.
+void
+_pybuffer_lock2(PyBufferObject *first, PyBufferObject *second)
+{
+    PyBufferObject *tmp;
+    if (first->owner != NULL && second->owner != NULL) {
+        return;
+    }
+    if (second->owner != NULL || (first->owner == NULL && second < first)) {
+        tmp = first;
+        first = second;
+        second = tmp;
+    }
+    evbuffer_lock(first->buffer);
+    evbuffer_lock(second->buffer);
+}
+
+void
+_pybuffer_unlock2(PyBufferObject *first, PyBufferObject *second)
+{
+    if (first->owner != NULL && second->owner != NULL) {
+        return;
+    }
+    evbuffer_unlock(first->buffer);
+    evbuffer_unlock(second->buffer);
+}
+
 static int
 pybuffer_init(PyBufferObject *self, PyObject *args, PyObject *kwds)
 {
+    if (self->exports > 0) {
+        _pybuffer_exported_error();
+        return -1;
+    }
+    
     self->buffer = evbuffer_new();
     if (self->buffer == NULL) {
         PyErr_NoMemory();
@@ -75,7 +143,10 @@ pybuffer_dealloc(PyBufferObject *self)
     }
     Py_END_ALLOW_THREADS
     Py_XDECREF(self->base);
-    Py_TYPE(self)->tp_free(self);
+    if (Py_TYPE(self) != &PyEventBuffer_Type ||
+        !pyfreelist_release(&pybuffer_freelist, (PyObject *) self)) {
+        Py_TYPE(self)->tp_free(self);
+    }
 }
 
 PyDoc_STRVAR(buffer_enable_locking_doc, "Enable locking on an evbuffer.");
@@ -87,6 +158,7 @@ pybuffer_enable_locking(PyBufferObject *self, PyObject *args)
     Py_BEGIN_ALLOW_THREADS
     evbuffer_enable_locking(self->buffer, NULL);
     Py_END_ALLOW_THREADS
+    self->locked = 1;
 #endif
     Py_RETURN_NONE;
 }
@@ -131,13 +203,18 @@ static PyObject *
 pybuffer_expand(PyBufferObject *self, PyObject *args)
 {
     Py_ssize_t size;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "n", &size))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    // Expanding might move the last chain
+    BEGIN_BUFFER_MODIFY(self, exported)
     evbuffer_expand(self->buffer, size);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     Py_RETURN_NONE;
 }
 
@@ -158,31 +235,47 @@ pybuffer_add(PyBufferObject *self, PyObject *args)
     PyObject *pydata;
     char *data;
     Py_ssize_t length;
-    int result;
+    int result=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "O", &pydata))
         return NULL;
 
     if (PyEventBuffer_Check(pydata)) {
+        PyBufferObject *other = (PyBufferObject *) pydata;
         Py_BEGIN_ALLOW_THREADS
-        result = evbuffer_add_buffer(self->buffer, ((PyBufferObject *) pydata)->buffer);
+        _pybuffer_lock2(self, other);
+        exported = self->exports > 0 || other->exports > 0;
+        if (!exported) {
+            result = evbuffer_add_buffer(self->buffer, other->buffer);
+            self->nreserved = other->nreserved = 0;
+        }
+        _pybuffer_unlock2(self, other);
         Py_END_ALLOW_THREADS
     } else {
         if (PyObject_AsReadBuffer(pydata, (const void **) &data, &length) != 0) {
             return NULL;
         }
         
+        // The reference to pydata is taken before releasing the lock, so
+        // the data can't be released before it is incremented.
         Py_BEGIN_ALLOW_THREADS
         evbuffer_lock(self->buffer);
-        result = evbuffer_add_reference(self->buffer, data, length, _pybuffer_decref, pydata);
+        exported = self->exports > 0;
+        if (!exported) {
+            result = evbuffer_add_reference(self->buffer, data, length, _pybuffer_decref, pydata);
+        }
         Py_END_ALLOW_THREADS
-        if (result >= 0) {
+        if (!exported && result >= 0) {
             Py_INCREF(pydata);
         }
         Py_BEGIN_ALLOW_THREADS
         evbuffer_unlock(self->buffer);
         Py_END_ALLOW_THREADS
     }
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not add data to buffer");
         return NULL;
@@ -201,6 +294,7 @@ pybuffer_remove(PyBufferObject *self, PyObject *args)
     Py_ssize_t length=-1;
     PyObject *result;
     int unlock=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "|n", &length))
         return NULL;
@@ -235,12 +329,18 @@ pybuffer_remove(PyBufferObject *self, PyObject *args)
     }
     
     data = PyString_AS_STRING(result);
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     size = evbuffer_remove(self->buffer, data, length);
+    END_BUFFER_MODIFY(self, exported)
     if (unlock) {
+        Py_BEGIN_ALLOW_THREADS
         evbuffer_unlock(self->buffer);
+        Py_END_ALLOW_THREADS
+    }
+    if (exported) {
+        Py_DECREF(result);
+        return _pybuffer_exported_error();
     }
-    Py_END_ALLOW_THREADS
     if (size < 0) {
         Py_DECREF(result);
         PyErr_SetString(PyExc_TypeError, "could not remove data from buffer");
@@ -323,15 +423,25 @@ static PyObject *
 pybuffer_remove_buffer(PyBufferObject *self, PyObject *args)
 {
     PyBufferObject *dst;
-    ev_ssize_t size;
+    ev_ssize_t size=0;
     Py_ssize_t length;
+    int exported;
     
-    if (!PyArg_ParseTuple(args, "O!n", &PyBuffer_Type, &dst, &length))
+    if (!PyArg_ParseTuple(args, "O!n", &PyEventBuffer_Type, &dst, &length))
         return NULL;
     
     Py_BEGIN_ALLOW_THREADS
-    size = evbuffer_remove_buffer(self->buffer, dst->buffer, length);
+    _pybuffer_lock2(self, dst);
+    exported = self->exports > 0 || dst->exports > 0;
+    if (!exported) {
+        size = evbuffer_remove_buffer(self->buffer, dst->buffer, length);
+        self->nreserved = dst->nreserved = 0;
+    }
+    _pybuffer_unlock2(self, dst);
     Py_END_ALLOW_THREADS
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (size < 0) {
         PyErr_SetString(PyExc_TypeError, "could not remove data from buffer");
         return NULL;
@@ -345,16 +455,20 @@ static PyObject *
 pybuffer_readln(PyBufferObject *self, PyObject *args)
 {
     int flags=EVBUFFER_EOL_ANY;
-    char *data;
+    char *data=NULL;
     size_t size;
     PyObject *result;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "|i", &flags))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     data = evbuffer_readln(self->buffer, &size, flags);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (data == NULL) {
         result = PyString_FromString("");
     } else {
@@ -372,14 +486,18 @@ pybuffer_add_file(PyBufferObject *self, PyObject *args)
     int fd;
     Py_ssize_t offset;
     Py_ssize_t length;
-    int result;
+    int result=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "inn", &fd, &offset, &length))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     result = evbuffer_add_file(self->buffer, fd, offset, length);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not add data from file to the buffer");
         return NULL;
@@ -393,14 +511,18 @@ static PyObject *
 pybuffer_drain(PyBufferObject *self, PyObject *args)
 {
     Py_ssize_t length;
-    int result;
+    int result=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "n", &length))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     result = evbuffer_drain(self->buffer, length);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not drain data from the buffer");
         return NULL;
@@ -414,19 +536,23 @@ static PyObject *
 pybuffer_write(PyBufferObject *self, PyObject *args)
 {
     int fd;
-    int result;
+    int result=0;
     int length=-1;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "i|i", &fd, &length))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     if (length < 0) {
         result = evbuffer_write(self->buffer, fd);
     } else {
         result = evbuffer_write_atmost(self->buffer, fd, length);
     }
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not write buffer to file descriptor");
         return NULL;
@@ -440,15 +566,19 @@ static PyObject *
 pybuffer_read(PyBufferObject *self, PyObject *args)
 {
     int fd;
-    int result;
+    int result=0;
     int length;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "ii", &fd, &length))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     result = evbuffer_read(self->buffer, fd, length);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not read buffer from file descriptor");
         return NULL;
@@ -462,13 +592,17 @@ static PyObject *
 pybuffer_pullup(PyBufferObject *self, PyObject *args)
 {
     Py_ssize_t length=-1;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "|n", &length))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_BUFFER_MODIFY(self, exported)
     evbuffer_pullup(self->buffer, length);
-    Py_END_ALLOW_THREADS
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     Py_RETURN_NONE;
 }
 
@@ -480,23 +614,34 @@ pybuffer_prepend(PyBufferObject *self, PyObject *args)
     PyObject *pydata;
     char *data;
     Py_ssize_t length;
-    int result;
+    int result=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "O", &pydata))
         return NULL;
     
     if (PyEventBuffer_Check(pydata)) {
+        PyBufferObject *other = (PyBufferObject *) pydata;
         Py_BEGIN_ALLOW_THREADS
-        result = evbuffer_prepend_buffer(self->buffer, ((PyBufferObject *) pydata)->buffer);
+        _pybuffer_lock2(self, other);
+        exported = self->exports > 0 || other->exports > 0;
+        if (!exported) {
+            result = evbuffer_prepend_buffer(self->buffer, other->buffer);
+            self->nreserved = other->nreserved = 0;
+        }
+        _pybuffer_unlock2(self, other);
         Py_END_ALLOW_THREADS
     } else {
         if (PyObject_AsReadBuffer(pydata, (const void **) &data, &length) != 0) {
             return NULL;
         }
         
-        Py_BEGIN_ALLOW_THREADS
+        BEGIN_BUFFER_MODIFY(self, exported)
         result = evbuffer_prepend(self->buffer, data, length);
-        Py_END_ALLOW_THREADS
+        END_BUFFER_MODIFY(self, exported)
+    }
+    if (exported) {
+        return _pybuffer_exported_error();
     }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not prepend data to buffer");
@@ -595,6 +740,324 @@ pybuffer_search(PyBufferObject *self, PyObject *args)
     return PyLong_FromSsize_t(pos.pos);
 }
 
+// Buffers of a BufferEvent are modified by libevent itself and can't be
+// exported.
+static int
+pybuffer_check_export(PyBufferObject *self)
+{
+    if (self->buffer == NULL) {
+        PyErr_SetString(PyExc_TypeError, "the buffer has been released");
+        return -1;
+    }
+    if (self->owner != NULL) {
+        PyErr_SetString(PyExc_BufferError, "can't export the buffer of a BufferEvent");
+        return -1;
+    }
+    return 0;
+}
+
+// Pull up length bytes (the first chain if negative) and register an export
+// of them under a single lock, so they can't be drained in between. The
+// export keeps all modifications away until it is released.
+static unsigned char *
+pybuffer_export(PyBufferObject *self, Py_ssize_t *length)
+{
+    unsigned char *data=NULL;
+    Py_ssize_t available;
+    int exported=0;
+    
+    if (pybuffer_check_export(self) < 0) {
+        return NULL;
+    }
+    
+    BEGIN_ALLOW_THREADS_IF(self->locked)
+    evbuffer_lock(self->buffer);
+    if (*length < 0) {
+        *length = evbuffer_get_contiguous_space(self->buffer);
+    }
+    available = evbuffer_get_length(self->buffer);
+    // Pulling up would move exported data
+    exported = self->exports > 0 &&
+        *length > (Py_ssize_t) evbuffer_get_contiguous_space(self->buffer);
+    if (!exported && *length <= available) {
+        data = *length > 0 ? evbuffer_pullup(self->buffer, *length) : (unsigned char *) "";
+        if (data != NULL) {
+            self->exports++;
+        }
+    }
+    evbuffer_unlock(self->buffer);
+    END_ALLOW_THREADS_IF
+    if (exported) {
+        PyErr_SetString(PyExc_BufferError, "can't pull up a buffer while views of it are exported");
+    } else if (data == NULL) {
+        PyErr_Format(PyExc_TypeError, "can't pull up %d bytes from the buffer", (int) *length);
+    }
+    return data;
+}
+
+static void
+pybuffer_pin(PyBufferObject *self)
+{
+    BEGIN_ALLOW_THREADS_IF(self->locked)
+    evbuffer_lock(self->buffer);
+    self->exports++;
+    evbuffer_unlock(self->buffer);
+    END_ALLOW_THREADS_IF
+}
+
+static void
+pybuffer_releasebuffer(PyBufferObject *self, Py_buffer *view)
+{
+    if (self->buffer == NULL) {
+        self->exports--;
+        return;
+    }
+    
+    BEGIN_ALLOW_THREADS_IF(self->locked)
+    evbuffer_lock(self->buffer);
+    self->exports--;
+    evbuffer_unlock(self->buffer);
+    END_ALLOW_THREADS_IF
+}
+
+PyDoc_STRVAR(buffer_view_doc, "Pull up the given number of bytes (defaults to all) into contiguous memory and return a read-only memoryview of them.");
+
+static PyObject *
+pybuffer_view(PyBufferObject *self, PyObject *args)
+{
+    Py_ssize_t length=-1;
+    Py_buffer info;
+    unsigned char *data;
+    PyObject *view;
+    
+    if (!PyArg_ParseTuple(args, "|n", &length))
+        return NULL;
+    
+    if (pybuffer_check_export(self) < 0)
+        return NULL;
+    
+    if (length < 0) {
+        BEGIN_ALLOW_THREADS_IF(self->locked)
+        length = evbuffer_get_length(self->buffer);
+        END_ALLOW_THREADS_IF
+    }
+    
+    data = pybuffer_export(self, &length);
+    if (data == NULL) {
+        return NULL;
+    }
+    
+    // The view releases the export registered above
+    if (PyBuffer_FillInfo(&info, (PyObject *) self, data, length, 1, PyBUF_FULL_RO) != 0) {
+        pybuffer_releasebuffer(self, NULL);
+        return NULL;
+    }
+    view = PyMemoryView_FromBuffer(&info);
+    if (view == NULL) {
+        PyBuffer_Release(&info);
+    }
+    return view;
+}
+
+// Return a memoryview of the given memory, which pins the buffer until it
+// is released.
+static PyObject *
+pybuffer_segment(PyBufferObject *self, struct evbuffer_iovec *vec, int readonly)
+{
+    PyObject *view;
+    PyBufferSegmentObject *segment = PyObject_New(PyBufferSegmentObject, &PyBufferSegment_Type);
+    if (segment == NULL) {
+        return NULL;
+    }
+    
+    Py_INCREF(self);
+    segment->buffer = self;
+    segment->data = vec->iov_base;
+    segment->length = vec->iov_len;
+    segment->readonly = readonly;
+    view = PyMemoryView_FromObject((PyObject *) segment);
+    Py_DECREF(segment);
+    return view;
+}
+
+PyDoc_STRVAR(buffer_peek_doc, "Return a list of read-only memoryviews of the chains holding the given number of bytes (-1 for all) from start on, without copying. The buffer can't be modified while the views exist.");
+
+static PyObject *
+pybuffer_peek(PyBufferObject *self, PyObject *args)
+{
+    Py_ssize_t length;
+    Py_ssize_t start=0;
+    struct evbuffer_ptr ptr;
+    struct evbuffer_iovec *vec;
+    int count=0;
+    int i;
+    int result;
+    PyObject *segments;
+    
+    if (!PyArg_ParseTuple(args, "n|n", &length, &start))
+        return NULL;
+    
+    if (start < 0) {
+        PyErr_Format(PyExc_TypeError, "can't peek from position %d", (int) start);
+        return NULL;
+    }
+    if (pybuffer_check_export(self) < 0) {
+        return NULL;
+    }
+    
+    // Pin the buffer while the segments are created, every segment pins
+    // it again for the lifetime of its views.
+    BEGIN_ALLOW_THREADS_IF(self->locked)
+    evbuffer_lock(self->buffer);
+    result = evbuffer_ptr_set(self->buffer, &ptr, start, EVBUFFER_PTR_SET);
+    if (result == 0) {
+        count = evbuffer_peek(self->buffer, length, &ptr, NULL, 0);
+        self->exports++;
+    }
+    evbuffer_unlock(self->buffer);
+    END_ALLOW_THREADS_IF
+    if (result != 0) {
+        PyErr_Format(PyExc_TypeError, "can't peek from position %d", (int) start);
+        return NULL;
+    }
+    
+    vec = PyMem_New(struct evbuffer_iovec, count);
+    segments = PyList_New(count);
+    if (vec == NULL || segments == NULL) {
+        pybuffer_releasebuffer(self, NULL);
+        PyMem_Free(vec);
+        Py_XDECREF(segments);
+        return PyErr_NoMemory();
+    }
+    
+    count = evbuffer_peek(self->buffer, length, &ptr, vec, count);
+    for (i=0; i<count; i++) {
+        PyObject *view;
+        // The last chain might hold more than the requested bytes
+        if (length >= 0 && (Py_ssize_t) vec[i].iov_len > length) {
+            vec[i].iov_len = length;
+        }
+        length -= vec[i].iov_len;
+        view = pybuffer_segment(self, &vec[i], 1);
+        if (view == NULL) {
+            break;
+        }
+        PyList_SET_ITEM(segments, i, view);
+    }
+    pybuffer_releasebuffer(self, NULL);
+    PyMem_Free(vec);
+    if (i < count) {
+        Py_DECREF(segments);
+        return NULL;
+    }
+    return segments;
+}
+
+PyDoc_STRVAR(buffer_reserve_doc, "Reserve space for at least the given number of bytes at the end of the buffer and return a list of writable memoryviews of it. The data written to them is added to the buffer by commit(). The buffer can't be modified otherwise while the views exist.");
+
+static PyObject *
+pybuffer_reserve(PyBufferObject *self, PyObject *args)
+{
+    Py_ssize_t length;
+    int count=0;
+    int i;
+    int exported;
+    PyObject *segments;
+    
+    if (!PyArg_ParseTuple(args, "n", &length))
+        return NULL;
+    
+    if (length <= 0) {
+        PyErr_Format(PyExc_TypeError, "can't reserve %d bytes in the buffer", (int) length);
+        return NULL;
+    }
+    if (pybuffer_check_export(self) < 0) {
+        return NULL;
+    }
+    
+    // Reserving might move the last chain. The buffer stays pinned while
+    // the segments are created, every segment pins it again for the
+    // lifetime of its views.
+    BEGIN_BUFFER_MODIFY(self, exported)
+    count = evbuffer_reserve_space(self->buffer, length, self->reserved, 2);
+    self->nreserved = count > 0 ? count : 0;
+    if (count > 0) {
+        self->exports++;
+    }
+    END_BUFFER_MODIFY(self, exported)
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
+    if (count <= 0) {
+        PyErr_Format(PyExc_TypeError, "can't reserve %d bytes in the buffer", (int) length);
+        return NULL;
+    }
+    
+    segments = PyList_New(count);
+    for (i=0; segments != NULL && i<count; i++) {
+        PyObject *view = pybuffer_segment(self, &self->reserved[i], 0);
+        if (view == NULL) {
+            Py_CLEAR(segments);
+            break;
+        }
+        PyList_SET_ITEM(segments, i, view);
+    }
+    pybuffer_releasebuffer(self, NULL);
+    return segments;
+}
+
+PyDoc_STRVAR(buffer_commit_doc, "Add the given number of bytes written to the views returned by reserve() to the buffer.");
+
+static PyObject *
+pybuffer_commit(PyBufferObject *self, PyObject *args)
+{
+    Py_ssize_t length;
+    Py_ssize_t remaining;
+    struct evbuffer_iovec vec[2];
+    int count=0;
+    int result=-1;
+    int reserved;
+    
+    if (!PyArg_ParseTuple(args, "n", &length))
+        return NULL;
+    
+    if (length < 0) {
+        PyErr_Format(PyExc_TypeError, "can't commit %d bytes to the buffer", (int) length);
+        return NULL;
+    }
+    
+    // Committing only advances the end of the reserved chains, so it is
+    // fine while views are exported. libevent refuses the space if the
+    // buffer has been modified since it was reserved.
+    BEGIN_ALLOW_THREADS_IF(self->locked)
+    evbuffer_lock(self->buffer);
+    reserved = self->nreserved;
+    remaining = length;
+    while (count < reserved && remaining > 0) {
+        vec[count] = self->reserved[count];
+        if ((Py_ssize_t) vec[count].iov_len > remaining) {
+            vec[count].iov_len = remaining;
+        }
+        remaining -= vec[count].iov_len;
+        count++;
+    }
+    if (reserved > 0 && remaining == 0) {
+        result = evbuffer_commit_space(self->buffer, vec, count);
+        self->nreserved = 0;
+    }
+    evbuffer_unlock(self->buffer);
+    END_ALLOW_THREADS_IF
+    if (reserved == 0) {
+        PyErr_SetString(PyExc_TypeError, "no space has been reserved");
+        return NULL;
+    }
+    if (result != 0) {
+        PyErr_Format(PyExc_TypeError, "can't commit %d bytes to the buffer", (int) length);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static PyMethodDef
 pybuffer_methods[] = {
     {"enable_locking", (PyCFunction)pybuffer_enable_locking, METH_NOARGS, buffer_enable_locking_doc},
@@ -619,6 +1082,10 @@ pybuffer_methods[] = {
     {"unfreeze", (PyCFunction)pybuffer_unfreeze, METH_VARARGS, buffer_unfreeze_doc},
     {"defer_callbacks", (PyCFunction)pybuffer_defer_callbacks, METH_VARARGS, buffer_defer_callbacks_doc},
     {"search", (PyCFunction)pybuffer_search, METH_VARARGS, buffer_search_doc},
+    {"view", (PyCFunction)pybuffer_view, METH_VARARGS, buffer_view_doc},
+    {"peek", (PyCFunction)pybuffer_peek, METH_VARARGS, buffer_peek_doc},
+    {"reserve", (PyCFunction)pybuffer_reserve, METH_VARARGS, buffer_reserve_doc},
+    {"commit", (PyCFunction)pybuffer_commit, METH_VARARGS, buffer_commit_doc},
     {NULL, NULL},
 };
 
@@ -626,9 +1093,9 @@ static Py_ssize_t
 pybuffer_length(PyBufferObject *self)
 {
     Py_ssize_t result;
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(self->locked)
     result = evbuffer_get_length(self->buffer);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
     return result;
 }
 
@@ -667,6 +1134,33 @@ pybuffer_as_mapping = {
 	NULL,  /*mp_subscript*/
 	NULL,  /*mp_ass_subscript*/
 };
+// Views of the first chain pin the buffer until they are released.
+static int
+pybuffer_getbuffer(PyBufferObject *self, Py_buffer *view, int flags)
+{
+    Py_ssize_t length=-1;
+    unsigned char *data = pybuffer_export(self, &length);
+    if (data == NULL) {
+        return -1;
+    }
+    
+    if (PyBuffer_FillInfo(view, (PyObject *) self, data, length, 1, flags) != 0) {
+        pybuffer_releasebuffer(self, view);
+        return -1;
+    }
+    return 0;
+}
+
+static PyBufferProcs
+pybuffer_as_buffer = {
+    0,                    /* bf_getreadbuffer */
+    0,                    /* bf_getwritebuffer */
+    0,                    /* bf_getsegcount */
+    0,                    /* bf_getcharbuffer */
+    (getbufferproc)pybuffer_getbuffer, /* bf_getbuffer */
+    (releasebufferproc)pybuffer_releasebuffer, /* bf_releasebuffer */
+};
+
 PyDoc_STRVAR(buffer_doc, "Buffer");
 
 PyTypeObject
@@ -690,8 +1184,8 @@ PyEventBuffer_Type = {
     0,                    /* tp_str */
     0,                    /* tp_getattro */
     0,                    /* tp_setattro */
-    0,                    /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE,   /* tp_flags */
+    &pybuffer_as_buffer,  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_NEWBUFFER,   /* tp_flags */
     buffer_doc,           /* tp_doc */
     0,                    /* tp_traverse */
     0,                    /* tp_clear */
@@ -712,3 +1206,88 @@ PyEventBuffer_Type = {
     pybuffer_new,         /* tp_new */
     0,                    /* tp_free */
 };
+
+static void
+pybuffersegment_dealloc(PyBufferSegmentObject *self)
+{
+    Py_XDECREF(self->buffer);
+    PyObject_Del(self);
+}
+
+// Every view of a segment pins its buffer, so the chain can't be freed
+// while it is in use.
+static int
+pybuffersegment_getbuffer(PyBufferSegmentObject *self, Py_buffer *view, int flags)
+{
+    if (pybuffer_check_export(self->buffer) < 0) {
+        return -1;
+    }
+    
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->data, self->length, self->readonly, flags) != 0) {
+        return -1;
+    }
+    pybuffer_pin(self->buffer);
+    return 0;
+}
+
+static void
+pybuffersegment_releasebuffer(PyBufferSegmentObject *self, Py_buffer *view)
+{
+    pybuffer_releasebuffer(self->buffer, view);
+}
+
+static PyBufferProcs
+pybuffersegment_as_buffer = {
+    0,                    /* bf_getreadbuffer */
+    0,                    /* bf_getwritebuffer */
+    0,                    /* bf_getsegcount */
+    0,                    /* bf_getcharbuffer */
+    (getbufferproc)pybuffersegment_getbuffer, /* bf_getbuffer */
+    (releasebufferproc)pybuffersegment_releasebuffer, /* bf_releasebuffer */
+};
+
+PyDoc_STRVAR(buffer_segment_doc, "Peeked or reserved segment of a Buffer");
+
+PyTypeObject
+PyBufferSegment_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.BufferSegment", /* tp_name */
+    sizeof(PyBufferSegmentObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pybuffersegment_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    &pybuffersegment_as_buffer, /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    buffer_segment_doc,   /* tp_doc */
+    0,                    /* tp_traverse */
+    0,                    /* tp_clear */
+    0,                    /* tp_richcompare */
+    0,                    /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    0,                    /* tp_methods */
+    0,                    /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    0,                    /* tp_init */
+    0,                    /* tp_alloc */
+    0,                    /* tp_new */
+    0,                    /* tp_free */
+};
@@ -26,11 +26,50 @@ typedef struct _PyBufferObject {
     struct evbuffer *buffer;
     PyEventBaseObject *base;
     int owned;
+    int locked;
+    // number of views exported through the buffer protocol, only changed
+    // with the lock of the evbuffer held
+    int exports;
+    // BufferEvent that owns the evbuffer if not owned, borrowed
+    PyObject *owner;
+    // space handed out by Buffer.reserve until it is committed, dropped by
+    // any other modification
+    struct evbuffer_iovec reserved[2];
+    int nreserved;
 } PyBufferObject;
 
+typedef struct _PyBufferSegmentObject {
+    PyObject_HEAD
+    PyBufferObject *buffer;
+    void *data;
+    Py_ssize_t length;
+    int readonly;
+} PyBufferSegmentObject;
+
 extern PyTypeObject PyEventBuffer_Type;
+extern PyTypeObject PyBufferSegment_Type;
+extern PyFreeList pybuffer_freelist;
 extern PyBufferObject *_pybuffer_create(struct evbuffer *buffer);
+extern void _pybuffer_detach(PyBufferObject *self);
+extern PyObject *_pybuffer_exported_error(void);
+extern void _pybuffer_lock2(PyBufferObject *first, PyBufferObject *second);
+extern void _pybuffer_unlock2(PyBufferObject *first, PyBufferObject *second);
+
+#define PyEventBuffer_Check(ob) PyObject_TypeCheck(ob, &PyEventBuffer_Type)
+
+// Modifications of a Buffer are refused while views of it are exported.
+// The check and the modification happen under the lock of the evbuffer,
+// so no view can be exported in between.
+#define BEGIN_BUFFER_MODIFY(self, exported) \
+    Py_BEGIN_ALLOW_THREADS \
+    evbuffer_lock((self)->buffer); \
+    exported = (self)->exports > 0; \
+    if (!exported) { \
+        (self)->nreserved = 0;
 
-#define PyEventBuffer_Check(ob) ((ob)->ob_type == &PyEventBuffer_Type)
+#define END_BUFFER_MODIFY(self, exported) \
+    } \
+    evbuffer_unlock((self)->buffer); \
+    Py_END_ALLOW_THREADS
 
 #endif
@@ -50,6 +50,9 @@ typedef struct _PyBufferEventObject {
     PyObject *eventcb;
     PyObject *cbdata;
     PyObject *weakrefs;
+    PyObject *argcache;
+    PyObject *eventargcache;
+    int options;
 } PyBufferEventObject;
 
 static void
@@ -57,14 +60,15 @@ _pybufferevent_readcb(struct bufferevent *bev, void *ctx)
 {
     PyBufferEventObject *self = (PyBufferEventObject *) ctx;
     if (self->readcb != NULL) {
-        START_BLOCK_THREADS
-        PyObject *result = PyObject_CallFunction(self->readcb, "OO", self, self->cbdata);
+        START_BASE_BLOCK_THREADS(self->base)
+        PyObject *argv[2] = {(PyObject *) self, self->cbdata};
+        PyObject *result = pybase_call(self->base, PYBASE_CB_BUFFEREVENT_READ, self->readcb, &self->argcache, 2, argv);
         if (result == NULL) {
             pybase_store_error(self->base);
         } else {
             Py_DECREF(result);
         }
-        END_BLOCK_THREADS
+        END_BASE_BLOCK_THREADS(self->base)
     }
 }
 
@@ -73,14 +77,15 @@ _pybufferevent_writecb(struct bufferevent *bev, void *ctx)
 {
     PyBufferEventObject *self = (PyBufferEventObject *) ctx;
     if (self->writecb != NULL) {
-        START_BLOCK_THREADS
-        PyObject *result = PyObject_CallFunction(self->writecb, "OO", self, self->cbdata);
+        START_BASE_BLOCK_THREADS(self->base)
+        PyObject *argv[2] = {(PyObject *) self, self->cbdata};
+        PyObject *result = pybase_call(self->base, PYBASE_CB_BUFFEREVENT_WRITE, self->writecb, &self->argcache, 2, argv);
         if (result == NULL) {
             pybase_store_error(self->base);
         } else {
             Py_DECREF(result);
         }
-        END_BLOCK_THREADS
+        END_BASE_BLOCK_THREADS(self->base)
     }
 }
 
@@ -89,14 +94,20 @@ _pybufferevent_eventcb(struct bufferevent *bev, short what, void *ctx)
 {
     PyBufferEventObject *self = (PyBufferEventObject *) ctx;
     if (self->eventcb != NULL) {
-        START_BLOCK_THREADS
-        PyObject *result = PyObject_CallFunction(self->eventcb, "OiO", self, what, self->cbdata);
+        START_BASE_BLOCK_THREADS(self->base)
+        PyObject *pywhat = PyInt_FromLong(what);
+        PyObject *argv[3] = {(PyObject *) self, pywhat, self->cbdata};
+        PyObject *result = NULL;
+        if (pywhat != NULL) {
+            result = pybase_call(self->base, PYBASE_CB_BUFFEREVENT_EVENT, self->eventcb, &self->eventargcache, 3, argv);
+            Py_DECREF(pywhat);
+        }
         if (result == NULL) {
             pybase_store_error(self->base);
         } else {
             Py_DECREF(result);
         }
-        END_BLOCK_THREADS
+        END_BASE_BLOCK_THREADS(self->base)
     }
 }
 
@@ -116,6 +127,8 @@ pybufferevent_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         s->eventcb = NULL;
         s->cbdata = NULL;
         s->weakrefs = NULL;
+        s->argcache = NULL;
+        s->eventargcache = NULL;
     }
     return (PyObject *)s;
 }
@@ -130,16 +143,33 @@ pybufferevent_init(PyBufferEventObject *self, PyObject *args, PyObject *kwds)
     if (!PyArg_ParseTuple(args, "O!|ii", &PyEventBase_Type, &base, &fd, &options))
         return -1;
 
+    if ((options & BEV_OPT_THREADSAFE) && base->batch_gil) {
+        PyErr_SetString(PyExc_TypeError, "can't create a threadsafe BufferEvent on a base that batches the GIL");
+        return -1;
+    }
+
     self->buffer = bufferevent_socket_new(base->base, fd, options);
     if (self->buffer == NULL) {
         PyErr_NoMemory();
         return -1;
     }
+    if (options & BEV_OPT_THREADSAFE) {
+        base->threadsafe_bufferevents++;
+    }
     
     self->base = base;
     Py_INCREF(base);
     self->input = _pybuffer_create(bufferevent_get_input(self->buffer));
     self->output = _pybuffer_create(bufferevent_get_output(self->buffer));
+    self->options = options;
+    if (self->input != NULL) {
+        self->input->locked = (options & BEV_OPT_THREADSAFE) != 0;
+        self->input->owner = (PyObject *) self;
+    }
+    if (self->output != NULL) {
+        self->output->locked = (options & BEV_OPT_THREADSAFE) != 0;
+        self->output->owner = (PyObject *) self;
+    }
     self->cbdata = Py_None;
     Py_INCREF(Py_None);
     return 0;
@@ -163,13 +193,16 @@ static int
 pybufferevent_clear(PyBufferEventObject *self)
 {
     if (self->input != NULL) {
-        self->input->buffer = NULL;
+        _pybuffer_detach(self->input);
         Py_CLEAR(self->input);
     }
     if (self->output != NULL) {
-        self->output->buffer = NULL;
+        _pybuffer_detach(self->output);
         Py_CLEAR(self->output);
     }
+    if (self->buffer != NULL && (self->options & BEV_OPT_THREADSAFE)) {
+        self->base->threadsafe_bufferevents--;
+    }
     Py_BEGIN_ALLOW_THREADS
     if (self->buffer != NULL) {
         bufferevent_free(self->buffer);
@@ -182,6 +215,8 @@ pybufferevent_clear(PyBufferEventObject *self)
     Py_CLEAR(self->eventcb);
     Py_CLEAR(self->cbdata);
     Py_CLEAR(self->base);
+    Py_CLEAR(self->argcache);
+    Py_CLEAR(self->eventargcache);
     return 0;
 }
 
@@ -226,48 +261,46 @@ pybufferevent_setcb(PyBufferEventObject *self, PyObject *args)
     PyObject *writecb;
     PyObject *eventcb;
     PyObject *cbdata=Py_None;
+    PyObject *oldreadcb;
+    PyObject *oldwritecb;
+    PyObject *oldeventcb;
+    PyObject *oldcbdata;
     
     if (!PyArg_ParseTuple(args, "OOO|O", &readcb, &writecb, &eventcb, &cbdata))
         return NULL;
     
-    // make changes atomic
+    // make changes atomic, libevent holds the lock while running callbacks
     Py_BEGIN_ALLOW_THREADS
     bufferevent_lock(self->buffer);
     Py_END_ALLOW_THREADS
     
-    if (self->readcb != readcb) {
-        PyObject *old = self->readcb;
-        self->readcb = (readcb == Py_None ? NULL : readcb);
-        Py_XINCREF(self->readcb);
-        Py_XDECREF(old);
-    }
-    if (self->writecb != writecb) {
-        PyObject *old = self->writecb;
-        self->writecb = (writecb == Py_None ? NULL : writecb);
-        Py_XINCREF(self->writecb);
-        Py_XDECREF(old);
-    }
-    if (self->eventcb != eventcb) {
-        PyObject *old = self->eventcb;
-        self->eventcb = (eventcb == Py_None ? NULL : eventcb);
-        Py_XINCREF(self->eventcb);
-        Py_XDECREF(old);
-    }
-    if (self->cbdata != cbdata) {
-        PyObject *old = self->cbdata;
-        self->cbdata = cbdata;
-        Py_INCREF(cbdata);
-        Py_XDECREF(old);
-    }
+    oldreadcb = self->readcb;
+    self->readcb = (readcb == Py_None ? NULL : readcb);
+    Py_XINCREF(self->readcb);
+    oldwritecb = self->writecb;
+    self->writecb = (writecb == Py_None ? NULL : writecb);
+    Py_XINCREF(self->writecb);
+    oldeventcb = self->eventcb;
+    self->eventcb = (eventcb == Py_None ? NULL : eventcb);
+    Py_XINCREF(self->eventcb);
+    oldcbdata = self->cbdata;
+    self->cbdata = cbdata;
+    Py_INCREF(cbdata);
     
-    Py_BEGIN_ALLOW_THREADS
+    // The lock is already held, so these don't block.
     bufferevent_setcb(self->buffer,
         readcb == Py_None ? NULL : _pybufferevent_readcb,
         writecb == Py_None ? NULL : _pybufferevent_writecb,
         eventcb == Py_None ? NULL : _pybufferevent_eventcb,
         self);
     bufferevent_unlock(self->buffer);
-    Py_END_ALLOW_THREADS
+    
+    // Releasing the old callbacks may run arbitrary code, which must not
+    // happen while holding the lock.
+    Py_XDECREF(oldreadcb);
+    Py_XDECREF(oldwritecb);
+    Py_XDECREF(oldeventcb);
+    Py_XDECREF(oldcbdata);
     Py_RETURN_NONE;
 }
 
@@ -288,14 +321,23 @@ pybufferevent_write(PyBufferEventObject *self, PyObject *args)
     PyObject *pydata;
     char *data;
     Py_ssize_t length;
-    int result;
+    int result=0;
+    int exported=0;
     
     if (!PyArg_ParseTuple(args, "O", &pydata))
         return NULL;
 
     if (PyEventBuffer_Check(pydata)) {
+        // Drains the source buffer
+        PyBufferObject *src = (PyBufferObject *) pydata;
         Py_BEGIN_ALLOW_THREADS
-        result = bufferevent_write_buffer(self->buffer, ((PyBufferObject *) pydata)->buffer);
+        _pybuffer_lock2(self->output, src);
+        exported = src->exports > 0;
+        if (!exported) {
+            src->nreserved = 0;
+            result = bufferevent_write_buffer(self->buffer, src->buffer);
+        }
+        _pybuffer_unlock2(self->output, src);
         Py_END_ALLOW_THREADS
     } else {
         if (PyObject_AsReadBuffer(pydata, (const void **) &data, &length) != 0) {
@@ -313,6 +355,9 @@ pybufferevent_write(PyBufferEventObject *self, PyObject *args)
         evbuffer_unlock(self->output->buffer);
         Py_END_ALLOW_THREADS
     }
+    if (exported) {
+        return _pybuffer_exported_error();
+    }
     if (result < 0) {
         PyErr_SetString(PyExc_TypeError, "could not write data to buffer");
         return NULL;
@@ -333,14 +378,26 @@ pybufferevent_read(PyBufferEventObject *self, PyObject *args)
     Py_ssize_t length;
     PyObject *result;
     int unlock=0;
+    int exported;
     
     if (!PyArg_ParseTuple(args, "|O", &pydest))
         return NULL;
     
     if (PyEventBuffer_Check(pydest)) {
+        PyBufferObject *dst = (PyBufferObject *) pydest;
+        size = 0;
         Py_BEGIN_ALLOW_THREADS
-        size = bufferevent_read_buffer(self->buffer, ((PyBufferObject *) pydest)->buffer);
+        _pybuffer_lock2(self->input, dst);
+        exported = dst->exports > 0;
+        if (!exported) {
+            dst->nreserved = 0;
+            size = bufferevent_read_buffer(self->buffer, dst->buffer);
+        }
+        _pybuffer_unlock2(self->input, dst);
         Py_END_ALLOW_THREADS
+        if (exported) {
+            return _pybuffer_exported_error();
+        }
         if (size != 0) {
             PyErr_SetString(PyExc_TypeError, "could not read data from buffer");
             return NULL;
@@ -401,6 +458,10 @@ pybufferevent_read(PyBufferEventObject *self, PyObject *args)
     return result;
 }
 
+// Neither the bufferevent nor its base have locks that could block.
+#define pybufferevent_nolock(self) \
+    (!((self)->options & BEV_OPT_THREADSAFE) && (self)->base->nolock)
+
 PyDoc_STRVAR(pybufferevent_enable_doc, "Enable a bufferevent.");
 
 static PyObject *
@@ -411,9 +472,9 @@ pybufferevent_enable(PyBufferEventObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "i", &what))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!pybufferevent_nolock(self))
     bufferevent_enable(self->buffer, what);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
@@ -427,9 +488,9 @@ pybufferevent_disable(PyBufferEventObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "i", &what))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!pybufferevent_nolock(self))
     bufferevent_disable(self->buffer, what);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
@@ -438,21 +499,22 @@ PyDoc_STRVAR(pybufferevent_set_timeouts_doc, "Set the read and write timeout for
 static PyObject *
 pybufferevent_set_timeouts(PyBufferEventObject *self, PyObject *args)
 {
-    double read;
-    double write;
+    PyObject *read;
+    PyObject *write;
     struct timeval read_tv;
     struct timeval write_tv;
+    const struct timeval *read_ptv;
+    const struct timeval *write_ptv;
     
-    if (!PyArg_ParseTuple(args, "dd", &read, &write))
+    if (!PyArg_ParseTuple(args, "OO", &read, &write))
         return NULL;
 
-    timeval_init(&read_tv, read);
-    timeval_init(&write_tv, write);
+    if (pybase_get_timeout(self->base, read, &read_tv, &read_ptv) != 0 ||
+        pybase_get_timeout(self->base, write, &write_tv, &write_ptv) != 0)
+        return NULL;
 
     Py_BEGIN_ALLOW_THREADS
-    bufferevent_set_timeouts(self->buffer,
-        read <= 0 ? NULL : &read_tv,
-        write <= 0 ? NULL : &write_tv);
+    bufferevent_set_timeouts(self->buffer, read_ptv, write_ptv);
     Py_END_ALLOW_THREADS
     Py_RETURN_NONE;
 }
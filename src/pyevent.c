@@ -20,67 +20,141 @@
 
 #include <Python.h>
 #include <structmember.h>
+#include <math.h>
 
 #include <event2/event.h>
 
 #include "pybase.h"
 #include "pyevent.h"
+#include "pyhistogram.h"
 
-typedef struct _PyEventObject {
-    PyObject_HEAD
-    PyEventBaseObject *base;
-    struct event *event;
-    PyObject *callback;
-    PyObject *userdata;
-    PyObject *weakrefs;
-    int fd;
-} PyEventObject;
+// Record how late a timeout fired, based on the cached time of the loop.
+static void
+pyevent_record_lag(PyEventObject *self, short what)
+{
+    struct timeval now;
+    struct timeval lag;
+    if (!self->has_deadline) {
+        return;
+    }
+    
+    event_base_gettimeofday_cached(self->base->base, &now);
+    if (what & EV_TIMEOUT) {
+        if (evutil_timercmp(&now, &self->deadline, >)) {
+            evutil_timersub(&now, &self->deadline, &lag);
+            pyhistogram_record(self->base->timer_lag,
+                (unsigned PY_LONG_LONG) lag.tv_sec * 1000000 + lag.tv_usec);
+        } else {
+            pyhistogram_record(self->base->timer_lag, 0);
+        }
+    }
+    
+    if (!(event_get_events(self->event) & EV_PERSIST)) {
+        self->has_deadline = 0;
+    } else if (what & EV_TIMEOUT) {
+        // Persistent timeouts are rescheduled relative to their deadline
+        evutil_timeradd(&self->deadline, &self->interval, &self->deadline);
+    } else {
+        evutil_timeradd(&now, &self->interval, &self->deadline);
+    }
+}
 
 static void
 pyevent_callback(evutil_socket_t fd, short what, void *userdata)
 {
     PyEventObject *self = (PyEventObject *) userdata;
-    START_BLOCK_THREADS
-    PyObject *result = PyObject_CallFunction(self->callback, "OiiO", self, fd, what, self->userdata);
+    START_BASE_BLOCK_THREADS(self->base)
+    pyevent_record_lag(self, what);
+    PyObject *pywhat = PyInt_FromLong(what);
+    PyObject *argv[4] = {(PyObject *) self, self->pyfd, pywhat, self->userdata};
+    PyObject *result = NULL;
+    if (pywhat != NULL) {
+        result = pybase_call(self->base, PYBASE_CB_EVENT, self->callback, &self->argcache, 4, argv);
+        Py_DECREF(pywhat);
+    }
     if (result == NULL) {
         pybase_store_error(self->base);
     } else {
         Py_DECREF(result);
     }
-    END_BLOCK_THREADS
+    END_BASE_BLOCK_THREADS(self->base)
 }
 
+static void
+pytimer_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    PyEventObject *self = (PyEventObject *) userdata;
+    START_BASE_BLOCK_THREADS(self->base)
+    pyevent_record_lag(self, what);
+    PyObject *argv[2] = {(PyObject *) self, self->userdata};
+    PyObject *result = pybase_call(self->base, PYBASE_CB_EVENT, self->callback, &self->argcache, 2, argv);
+    if (result == NULL) {
+        pybase_store_error(self->base);
+    } else {
+        Py_DECREF(result);
+    }
+    END_BASE_BLOCK_THREADS(self->base)
+}
+
+static void
+pysignal_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    PyEventObject *self = (PyEventObject *) userdata;
+    START_BASE_BLOCK_THREADS(self->base)
+    pyevent_record_lag(self, what);
+    PyObject *argv[3] = {(PyObject *) self, self->pyfd, self->userdata};
+    PyObject *result = pybase_call(self->base, PYBASE_CB_EVENT, self->callback, &self->argcache, 3, argv);
+    if (result == NULL) {
+        pybase_store_error(self->base);
+    } else {
+        Py_DECREF(result);
+    }
+    END_BASE_BLOCK_THREADS(self->base)
+}
+
+// Shared by the types that have the size of an event, subclasses are
+// always allocated by their type.
+PyFreeList pyevent_freelist = PYFREELIST_INIT("event", &PyEvent_Type);
+
+#define pyevent_recyclable(type) \
+    ((type) == &PyEvent_Type || (type) == &PyTimer_Type || (type) == &PySignal_Type)
+
 static PyObject *
 pyevent_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    PyEventObject *s = (PyEventObject *)type->tp_alloc(type, 0);
+    PyEventObject *s;
+    if (pyevent_recyclable(type)) {
+        s = (PyEventObject *)pyfreelist_alloc(&pyevent_freelist, type);
+    } else {
+        s = (PyEventObject *)type->tp_alloc(type, 0);
+    }
     if (s != NULL) {
         s->base = NULL;
         s->event = NULL;
         s->callback = NULL;
         s->userdata = NULL;
         s->weakrefs = NULL;
+        s->pyfd = NULL;
+        s->argcache = NULL;
+        s->has_deadline = 0;
     }
     return (PyObject *)s;
 }
 
 static int
-pyevent_init(PyEventObject *self, PyObject *args, PyObject *kwds)
+pyevent_setup(PyEventObject *self, PyEventBaseObject *base, int fd, int event, event_callback_fn fn, PyObject *callback, PyObject *userdata)
 {
-    PyEventBaseObject *base;
-    int fd;
-    int event;
-    PyObject *callback;
-    PyObject *userdata = Py_None;
-    if (!PyArg_ParseTuple(args, "O!iiO|O", &PyEventBase_Type, &base, &fd, &event, &callback, &userdata))
-        return -1;
-
     if (!PyCallable_Check(callback)) {
         PyErr_SetString(PyExc_TypeError, "the callback must be callable");
         return -1;
     }
 
-    self->event = event_new(base->base, fd, event, pyevent_callback, self);
+    self->pyfd = PyInt_FromLong(fd);
+    if (self->pyfd == NULL) {
+        return -1;
+    }
+
+    self->event = event_new(base->base, fd, event, fn, self);
     if (self->event == NULL) {
         PyErr_NoMemory();
         return -1;
@@ -96,6 +170,47 @@ pyevent_init(PyEventObject *self, PyObject *args, PyObject *kwds)
     return 0;
 }
 
+static int
+pyevent_init(PyEventObject *self, PyObject *args, PyObject *kwds)
+{
+    PyEventBaseObject *base;
+    int fd;
+    int event;
+    PyObject *callback;
+    PyObject *userdata = Py_None;
+    if (!PyArg_ParseTuple(args, "O!iiO|O", &PyEventBase_Type, &base, &fd, &event, &callback, &userdata))
+        return -1;
+
+    return pyevent_setup(self, base, fd, event, pyevent_callback, callback, userdata);
+}
+
+static int
+pytimer_init(PyEventObject *self, PyObject *args, PyObject *kwds)
+{
+    PyEventBaseObject *base;
+    PyObject *callback;
+    PyObject *userdata = Py_None;
+    static char *kwlist[] = {"base", "callback", "userdata", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O|O", kwlist, &PyEventBase_Type, &base, &callback, &userdata))
+        return -1;
+
+    return pyevent_setup(self, base, -1, 0, pytimer_callback, callback, userdata);
+}
+
+static int
+pysignal_init(PyEventObject *self, PyObject *args, PyObject *kwds)
+{
+    PyEventBaseObject *base;
+    int signum;
+    PyObject *callback;
+    PyObject *userdata = Py_None;
+    static char *kwlist[] = {"base", "signum", "callback", "userdata", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!iO|O", kwlist, &PyEventBase_Type, &base, &signum, &callback, &userdata))
+        return -1;
+
+    return pyevent_setup(self, base, signum, EV_SIGNAL|EV_PERSIST, pysignal_callback, callback, userdata);
+}
+
 static int
 pyevent_traverse(PyEventObject *self, visitproc visit, void *arg)
 {
@@ -117,17 +232,23 @@ pyevent_clear(PyEventObject *self)
     Py_CLEAR(self->callback);
     Py_CLEAR(self->userdata);
     Py_CLEAR(self->base);
+    Py_CLEAR(self->pyfd);
+    Py_CLEAR(self->argcache);
     return 0;
 }
 
 static void
 pyevent_dealloc(PyEventObject *self)
 {
+    PyObject_GC_UnTrack(self);
     if (self->weakrefs != NULL) {
         PyObject_ClearWeakRefs((PyObject *) self);
     }
     pyevent_clear(self);
-    Py_TYPE(self)->tp_free(self);
+    if (!pyevent_recyclable(Py_TYPE(self)) ||
+        !pyfreelist_release(&pyevent_freelist, (PyObject *) self)) {
+        Py_TYPE(self)->tp_free(self);
+    }
 }
 
 PyDoc_STRVAR(event_add_doc, "Add event.");
@@ -135,19 +256,61 @@ PyDoc_STRVAR(event_add_doc, "Add event.");
 static PyObject *
 pyevent_add(PyEventObject *self, PyObject *args)
 {
-    double time=-1;
+    PyObject *timeout=NULL;
     struct timeval tv;
-    if (!PyArg_ParseTuple(args, "|d", &time))
+    const struct timeval *ptv;
+    if (!PyArg_ParseTuple(args, "|O", &timeout))
         return NULL;
     
-    timeval_init(&tv, time);
-    Py_BEGIN_ALLOW_THREADS
-    if (time <= 0) {
-        event_add(self->event, NULL);
+    if (pybase_get_timeout(self->base, timeout, &tv, &ptv) != 0)
+        return NULL;
+    
+    BEGIN_ALLOW_THREADS_IF(!self->base->nolock)
+    if (ptv != NULL) {
+        event_base_gettimeofday_cached(self->base->base, &self->deadline);
+        evutil_timeradd(&self->deadline, &tv, &self->deadline);
+        self->interval = tv;
+    }
+    event_add(self->event, ptv);
+    END_ALLOW_THREADS_IF
+    self->has_deadline = (ptv != NULL);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(event_add_at_doc, "Add the event with a timeout that expires at an absolute time of Base.now(), not supported for persistent events.");
+
+static PyObject *
+pyevent_add_at(PyEventObject *self, PyObject *args)
+{
+    double deadline;
+    double now;
+    struct timeval tv;
+    struct timeval cached;
+    if (!PyArg_ParseTuple(args, "d", &deadline))
+        return NULL;
+
+    if (event_get_events(self->event) & EV_PERSIST) {
+        // libevent would re-arm it with the remaining time as interval
+        PyErr_SetString(PyExc_TypeError, "can't add a persistent event at a deadline");
+        return NULL;
+    }
+    
+    // The GIL is kept, the cached time is only protected by the base lock
+    event_base_gettimeofday_cached(self->base->base, &cached);
+    now = cached.tv_sec + cached.tv_usec / 1000000.0;
+    if (deadline > now) {
+        timeval_init(&tv, deadline - now);
     } else {
-        event_add(self->event, &tv);
+        // Already expired, run in the next loop iteration
+        evutil_timerclear(&tv);
     }
-    Py_END_ALLOW_THREADS
+    
+    BEGIN_ALLOW_THREADS_IF(!self->base->nolock)
+    event_add(self->event, &tv);
+    END_ALLOW_THREADS_IF
+    evutil_timeradd(&cached, &tv, &self->deadline);
+    self->interval = tv;
+    self->has_deadline = 1;
     Py_RETURN_NONE;
 }
 
@@ -156,9 +319,25 @@ PyDoc_STRVAR(event_delete_doc, "Remove timer event.");
 static PyObject *
 pyevent_delete(PyEventObject *self, PyObject *args)
 {
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!self->base->nolock)
     event_del(self->event);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
+    self->has_deadline = 0;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(event_activate_doc, "Make the event active, its callback is run with the given flags in the next loop iteration.");
+
+static PyObject *
+pyevent_activate(PyEventObject *self, PyObject *args)
+{
+    int what;
+    if (!PyArg_ParseTuple(args, "i", &what))
+        return NULL;
+    
+    BEGIN_ALLOW_THREADS_IF(!self->base->nolock)
+    event_active(self->event, what, 1);
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
@@ -171,17 +350,19 @@ pyevent_set_priority(PyEventObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "i", &priority))
         return NULL;
     
-    Py_BEGIN_ALLOW_THREADS
+    BEGIN_ALLOW_THREADS_IF(!self->base->nolock)
     event_priority_set(self->event, priority);
-    Py_END_ALLOW_THREADS
+    END_ALLOW_THREADS_IF
     Py_RETURN_NONE;
 }
 
 static PyMethodDef
 pyevent_methods[] = {
     {"add", (PyCFunction)pyevent_add, METH_VARARGS, event_add_doc},
+    {"add_at", (PyCFunction)pyevent_add_at, METH_VARARGS, event_add_at_doc},
     {"delete", (PyCFunction)pyevent_delete, METH_NOARGS, event_delete_doc},
     {"set_priority", (PyCFunction)pyevent_set_priority, METH_VARARGS, event_set_priority_doc},
+    {"activate", (PyCFunction)pyevent_activate, METH_VARARGS, event_activate_doc},
     {NULL, NULL},
 };
 
@@ -239,3 +420,322 @@ PyEvent_Type = {
     pyevent_new,            /* tp_new */
     0,                    /* tp_free */
 };
+
+PyDoc_STRVAR(timer_doc, "Simplified event for timers.");
+
+PyTypeObject
+PyTimer_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.Timer",         /* tp_name */
+    sizeof(PyEventObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pyevent_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_WEAKREFS,   /* tp_flags */
+    timer_doc,            /* tp_doc */
+    (traverseproc)pyevent_traverse, /* tp_traverse */
+    (inquiry)pyevent_clear, /* tp_clear */
+    0,                    /* tp_richcompare */
+    offsetof(PyEventObject, weakrefs),  /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    0,                    /* tp_methods */
+    0,                    /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    (initproc)pytimer_init, /* tp_init */
+    0,                    /* tp_alloc */
+    pyevent_new,            /* tp_new */
+    0,                    /* tp_free */
+};
+
+PyDoc_STRVAR(signal_doc, "Simplified event for signals.");
+
+PyTypeObject
+PySignal_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.Signal",         /* tp_name */
+    sizeof(PyEventObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pyevent_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_WEAKREFS,   /* tp_flags */
+    signal_doc,            /* tp_doc */
+    (traverseproc)pyevent_traverse, /* tp_traverse */
+    (inquiry)pyevent_clear, /* tp_clear */
+    0,                    /* tp_richcompare */
+    offsetof(PyEventObject, weakrefs),  /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    0,                    /* tp_methods */
+    0,                    /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    (initproc)pysignal_init, /* tp_init */
+    0,                    /* tp_alloc */
+    pyevent_new,            /* tp_new */
+    0,                    /* tp_free */
+};
+
+typedef struct _PyPeriodicTimerObject {
+    PyEventObject event;
+    double interval;
+    double deadline;
+    int policy;
+    int active;
+    unsigned long ticks;
+    unsigned long missed;
+} PyPeriodicTimerObject;
+
+// Arm the timeout for the absolute deadline on the monotonic clock.
+static void
+pyperiodic_schedule(PyPeriodicTimerObject *self, double now)
+{
+    struct timeval tv;
+    if (self->deadline > now) {
+        timeval_init(&tv, self->deadline - now);
+    } else {
+        // Behind schedule, run in the next loop iteration
+        evutil_timerclear(&tv);
+    }
+    
+    BEGIN_ALLOW_THREADS_IF(!self->event.base->nolock)
+    event_add(self->event.event, &tv);
+    END_ALLOW_THREADS_IF
+}
+
+// Compute the deadline following the tick that was due at self->deadline.
+static void
+pyperiodic_advance(PyPeriodicTimerObject *self, double now)
+{
+    double next = self->deadline + self->interval;
+    double behind;
+    if (next > now) {
+        self->deadline = next;
+        return;
+    }
+    
+    behind = floor((now - self->deadline) / self->interval);
+    if (behind < 1) {
+        behind = 1;
+    }
+    switch (self->policy) {
+    case PERIODIC_SKIP:
+        // Drop the missed ticks but keep the phase of the schedule
+        self->missed += (unsigned long) behind;
+        self->deadline += (behind + 1) * self->interval;
+        break;
+    case PERIODIC_COALESCE:
+        // Run the missed ticks as one call now and restart the schedule
+        self->missed += (unsigned long) behind - 1;
+        self->deadline = now;
+        break;
+    default:
+        // Run every missed tick, one per loop iteration
+        self->deadline = next;
+        break;
+    }
+}
+
+static void
+pyperiodic_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    PyPeriodicTimerObject *self = (PyPeriodicTimerObject *) userdata;
+    START_BASE_BLOCK_THREADS(self->event.base)
+    double now = pybase_monotonic();
+    PyObject *argv[2];
+    PyObject *result;
+    if (now + 0.000001 < self->deadline) {
+        // The loop clock may run slightly ahead of ours
+        pyperiodic_schedule(self, now);
+        goto done;
+    }
+    
+    pyhistogram_record(self->event.base->timer_lag,
+        (unsigned PY_LONG_LONG) ((now - self->deadline) * 1000000));
+    // The callback might release the last reference to the timer
+    Py_INCREF(self);
+    self->ticks++;
+    argv[0] = (PyObject *) self;
+    argv[1] = self->event.userdata;
+    result = pybase_call(self->event.base, PYBASE_CB_EVENT, self->event.callback, &self->event.argcache, 2, argv);
+    if (result == NULL) {
+        pybase_store_error(self->event.base);
+    } else {
+        Py_DECREF(result);
+    }
+    
+    // The callback might have stopped or restarted the timer
+    if (self->active && self->event.event != NULL &&
+        !event_pending(self->event.event, EV_TIMEOUT, NULL)) {
+        now = pybase_monotonic();
+        pyperiodic_advance(self, now);
+        pyperiodic_schedule(self, now);
+    }
+    Py_DECREF(self);
+done:
+    END_BASE_BLOCK_THREADS(self->event.base)
+}
+
+static int
+pyperiodic_init(PyPeriodicTimerObject *self, PyObject *args, PyObject *kwds)
+{
+    PyEventBaseObject *base;
+    double interval;
+    PyObject *callback;
+    PyObject *userdata = Py_None;
+    int policy = PERIODIC_SKIP;
+    static char *kwlist[] = {"base", "interval", "callback", "userdata", "policy", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!dO|Oi", kwlist, &PyEventBase_Type, &base, &interval, &callback, &userdata, &policy))
+        return -1;
+    
+    if (interval <= 0) {
+        PyErr_SetString(PyExc_TypeError, "the interval must be positive");
+        return -1;
+    }
+    
+    if (policy != PERIODIC_SKIP && policy != PERIODIC_COALESCE && policy != PERIODIC_CATCH_UP) {
+        PyErr_Format(PyExc_TypeError, "unknown policy %d", policy);
+        return -1;
+    }
+    
+    self->interval = interval;
+    self->policy = policy;
+    return pyevent_setup(&self->event, base, -1, 0, pyperiodic_callback, callback, userdata);
+}
+
+PyDoc_STRVAR(periodic_start_doc, "Start the timer, the first tick is due after the given delay (defaults to the interval).");
+
+static PyObject *
+pyperiodic_start(PyPeriodicTimerObject *self, PyObject *args)
+{
+    double delay = self->interval;
+    double now;
+    if (!PyArg_ParseTuple(args, "|d", &delay))
+        return NULL;
+    
+    now = pybase_monotonic();
+    self->deadline = now + delay;
+    self->active = 1;
+    pyperiodic_schedule(self, now);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(periodic_stop_doc, "Stop the timer.");
+
+static PyObject *
+pyperiodic_stop(PyPeriodicTimerObject *self, PyObject *args)
+{
+    self->active = 0;
+    BEGIN_ALLOW_THREADS_IF(!self->event.base->nolock)
+    event_del(self->event.event);
+    END_ALLOW_THREADS_IF
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef
+pyperiodic_methods[] = {
+    {"start", (PyCFunction)pyperiodic_start, METH_VARARGS, periodic_start_doc},
+    {"stop", (PyCFunction)pyperiodic_stop, METH_NOARGS, periodic_stop_doc},
+    {NULL, NULL},
+};
+
+static PyMemberDef
+pyperiodic_members[] = {
+    {"interval", T_DOUBLE, offsetof(PyPeriodicTimerObject, interval), READONLY, "the interval between two ticks in seconds"},
+    {"deadline", T_DOUBLE, offsetof(PyPeriodicTimerObject, deadline), READONLY, "the time of Base.monotonic() the next tick is due"},
+    {"policy", T_INT, offsetof(PyPeriodicTimerObject, policy), READONLY, "how missed ticks are handled"},
+    {"ticks", T_ULONG, offsetof(PyPeriodicTimerObject, ticks), READONLY, "the number of times the callback was run"},
+    {"missed", T_ULONG, offsetof(PyPeriodicTimerObject, missed), READONLY, "the number of ticks that were dropped"},
+    {NULL}
+};
+
+PyDoc_STRVAR(periodic_doc, "PeriodicTimer(base, interval, callback, userdata=None, policy=PERIODIC_SKIP)\n\
+\n\
+Timer that runs callback(timer, userdata) every interval seconds once\n\
+started. Ticks are due at absolute deadlines on the monotonic clock, so the\n\
+runtime of the callback and the lag of the loop do not add up. If the loop\n\
+falls behind by more than an interval, PERIODIC_SKIP drops the missed ticks\n\
+and keeps the phase, PERIODIC_COALESCE runs them as one call and restarts\n\
+the schedule from there, and PERIODIC_CATCH_UP runs all of them, one per\n\
+loop iteration.");
+
+PyTypeObject
+PyPeriodicTimer_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.PeriodicTimer", /* tp_name */
+    sizeof(PyPeriodicTimerObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pyevent_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_WEAKREFS,   /* tp_flags */
+    periodic_doc,         /* tp_doc */
+    (traverseproc)pyevent_traverse, /* tp_traverse */
+    (inquiry)pyevent_clear, /* tp_clear */
+    0,                    /* tp_richcompare */
+    offsetof(PyEventObject, weakrefs),  /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    pyperiodic_methods,   /* tp_methods */
+    pyperiodic_members,   /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    (initproc)pyperiodic_init, /* tp_init */
+    0,                    /* tp_alloc */
+    pyevent_new,            /* tp_new */
+    0,                    /* tp_free */
+};
@@ -21,6 +21,37 @@
 #ifndef ___EVENT_PYEVENT__H___
 #define ___EVENT_PYEVENT__H___
 
+#include <Python.h>
+#include <event2/event.h>
+
+#include "pybase.h"
+
+typedef struct _PyEventObject {
+    PyObject_HEAD
+    PyEventBaseObject *base;
+    struct event *event;
+    PyObject *callback;
+    PyObject *userdata;
+    PyObject *weakrefs;
+    PyObject *pyfd;
+    PyObject *argcache;
+    int fd;
+    int has_deadline;
+    struct timeval deadline;
+    struct timeval interval;
+} PyEventObject;
+
 extern PyTypeObject PyEvent_Type;
+extern PyTypeObject PyTimer_Type;
+extern PyTypeObject PySignal_Type;
+extern PyTypeObject PyPeriodicTimer_Type;
+extern PyFreeList pyevent_freelist;
+
+// Policies of PeriodicTimer for ticks that were missed
+#define PERIODIC_SKIP 0
+#define PERIODIC_COALESCE 1
+#define PERIODIC_CATCH_UP 2
+
+#define PyEvent_Check(ob) PyObject_TypeCheck(ob, &PyEvent_Type)
 
 #endif
@@ -0,0 +1,307 @@
+/*
+ * Python Bindings for libevent
+ *
+ * Copyright (c) 2010-2011 by Joachim Bauch, mail@joachim-bauch.de
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <Python.h>
+#include <structmember.h>
+
+#include "pybase.h"
+#include "pyhistogram.h"
+
+static int
+pyhistogram_index(unsigned PY_LONG_LONG value)
+{
+    int shift = 0;
+    unsigned PY_LONG_LONG top = value >> (PYHISTOGRAM_SUB_BITS + 1);
+    while (top != 0) {
+        top >>= 1;
+        shift++;
+    }
+    if (shift > PYHISTOGRAM_MAX_SHIFT) {
+        // Clamp to the last bucket
+        return PYHISTOGRAM_BUCKETS - 1;
+    }
+    return (shift * PYHISTOGRAM_SUB_COUNT) + (int) (value >> shift);
+}
+
+static unsigned PY_LONG_LONG
+pyhistogram_lower_bound(int index)
+{
+    int shift = index / PYHISTOGRAM_SUB_COUNT - 1;
+    if (shift <= 0) {
+        return index;
+    }
+    return ((unsigned PY_LONG_LONG) (index - shift * PYHISTOGRAM_SUB_COUNT)) << shift;
+}
+
+static unsigned PY_LONG_LONG
+pyhistogram_upper_bound(int index)
+{
+    int shift = index / PYHISTOGRAM_SUB_COUNT - 1;
+    if (shift <= 0) {
+        return index;
+    }
+    return pyhistogram_lower_bound(index) + (((unsigned PY_LONG_LONG) 1) << shift) - 1;
+}
+
+PyHistogramObject *
+pyhistogram_new(void)
+{
+    PyHistogramObject *self = PyObject_New(PyHistogramObject, &PyHistogram_Type);
+    if (self != NULL) {
+        pyhistogram_reset(self);
+    }
+    return self;
+}
+
+void
+pyhistogram_record(PyHistogramObject *self, unsigned PY_LONG_LONG value)
+{
+    if (self->count == 0 || value < self->min) {
+        self->min = value;
+    }
+    if (value > self->max) {
+        self->max = value;
+    }
+    self->count++;
+    self->total += value / 1000000.0;
+    self->buckets[pyhistogram_index(value)]++;
+}
+
+void
+pyhistogram_reset(PyHistogramObject *self)
+{
+    self->count = 0;
+    self->min = 0;
+    self->max = 0;
+    self->total = 0.0;
+    memset(self->buckets, 0, sizeof(self->buckets));
+}
+
+static PyObject *
+pyhistogram_new_type(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyHistogramObject *s;
+    s = (PyHistogramObject *)type->tp_alloc(type, 0);
+    if (s != NULL) {
+        pyhistogram_reset(s);
+    }
+    return (PyObject *)s;
+}
+
+static void
+pyhistogram_dealloc(PyHistogramObject *self)
+{
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyDoc_STRVAR(pyhistogram_record_doc, "Record a value in seconds.");
+
+static PyObject *
+pyhistogram_record_value(PyHistogramObject *self, PyObject *args)
+{
+    double value;
+    if (!PyArg_ParseTuple(args, "d", &value))
+        return NULL;
+
+    if (value < 0) {
+        PyErr_SetString(PyExc_TypeError, "can't record negative values");
+        return NULL;
+    }
+
+    pyhistogram_record(self, (unsigned PY_LONG_LONG) (value * 1000000.0 + 0.5));
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(pyhistogram_min_doc, "Return the smallest recorded value in seconds.");
+
+static PyObject *
+pyhistogram_min(PyHistogramObject *self, PyObject *args)
+{
+    return PyFloat_FromDouble(self->min / 1000000.0);
+}
+
+PyDoc_STRVAR(pyhistogram_max_doc, "Return the largest recorded value in seconds.");
+
+static PyObject *
+pyhistogram_max(PyHistogramObject *self, PyObject *args)
+{
+    return PyFloat_FromDouble(self->max / 1000000.0);
+}
+
+PyDoc_STRVAR(pyhistogram_mean_doc, "Return the mean of the recorded values in seconds.");
+
+static PyObject *
+pyhistogram_mean(PyHistogramObject *self, PyObject *args)
+{
+    if (self->count == 0) {
+        return PyFloat_FromDouble(0.0);
+    }
+    return PyFloat_FromDouble(self->total / self->count);
+}
+
+PyDoc_STRVAR(pyhistogram_percentile_doc, "Return the value in seconds below which the given percentage of recorded values fall.");
+
+static PyObject *
+pyhistogram_percentile(PyHistogramObject *self, PyObject *args)
+{
+    double percentile;
+    unsigned PY_LONG_LONG wanted;
+    unsigned PY_LONG_LONG seen = 0;
+    unsigned PY_LONG_LONG value;
+    int i;
+    if (!PyArg_ParseTuple(args, "d", &percentile))
+        return NULL;
+
+    if (percentile < 0 || percentile > 100) {
+        PyErr_SetString(PyExc_TypeError, "percentile must be between 0 and 100");
+        return NULL;
+    }
+
+    if (self->count == 0) {
+        return PyFloat_FromDouble(0.0);
+    }
+
+    wanted = (unsigned PY_LONG_LONG) (percentile / 100.0 * self->count + 0.5);
+    if (wanted == 0) {
+        wanted = 1;
+    }
+    for (i = 0; i < PYHISTOGRAM_BUCKETS; i++) {
+        seen += self->buckets[i];
+        if (seen >= wanted) {
+            break;
+        }
+    }
+    // Report the highest value of the bucket, but never beyond the
+    // recorded range.
+    value = pyhistogram_upper_bound(i);
+    if (value > self->max) {
+        value = self->max;
+    } else if (value < self->min) {
+        value = self->min;
+    }
+    return PyFloat_FromDouble(value / 1000000.0);
+}
+
+PyDoc_STRVAR(pyhistogram_buckets_doc, "Return a list of (lower, upper, count) tuples for all non-empty buckets, bounds are in seconds.");
+
+static PyObject *
+pyhistogram_buckets(PyHistogramObject *self, PyObject *args)
+{
+    PyObject *result;
+    int i;
+
+    result = PyList_New(0);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < PYHISTOGRAM_BUCKETS; i++) {
+        PyObject *item;
+        if (self->buckets[i] == 0) {
+            continue;
+        }
+
+        item = Py_BuildValue("(ddK)",
+            pyhistogram_lower_bound(i) / 1000000.0,
+            pyhistogram_upper_bound(i) / 1000000.0,
+            self->buckets[i]);
+        if (item == NULL || PyList_Append(result, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return result;
+}
+
+PyDoc_STRVAR(pyhistogram_reset_doc, "Remove all recorded values.");
+
+static PyObject *
+pyhistogram_reset_values(PyHistogramObject *self, PyObject *args)
+{
+    pyhistogram_reset(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef
+pyhistogram_methods[] = {
+    {"record", (PyCFunction)pyhistogram_record_value, METH_VARARGS, pyhistogram_record_doc},
+    {"min", (PyCFunction)pyhistogram_min, METH_NOARGS, pyhistogram_min_doc},
+    {"max", (PyCFunction)pyhistogram_max, METH_NOARGS, pyhistogram_max_doc},
+    {"mean", (PyCFunction)pyhistogram_mean, METH_NOARGS, pyhistogram_mean_doc},
+    {"percentile", (PyCFunction)pyhistogram_percentile, METH_VARARGS, pyhistogram_percentile_doc},
+    {"buckets", (PyCFunction)pyhistogram_buckets, METH_NOARGS, pyhistogram_buckets_doc},
+    {"reset", (PyCFunction)pyhistogram_reset_values, METH_NOARGS, pyhistogram_reset_doc},
+    {NULL, NULL},
+};
+
+static PyMemberDef
+pyhistogram_members[] = {
+    {"count", T_ULONGLONG, offsetof(PyHistogramObject, count), READONLY, "number of recorded values"},
+    {"total", T_DOUBLE, offsetof(PyHistogramObject, total), READONLY, "sum of the recorded values in seconds"},
+    {NULL}
+};
+
+PyDoc_STRVAR(pyhistogram_doc, "Histogram of durations with logarithmic buckets");
+
+PyTypeObject
+PyHistogram_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.Histogram",    /* tp_name */
+    sizeof(PyHistogramObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pyhistogram_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    0,                    /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,   /* tp_flags */
+    pyhistogram_doc,      /* tp_doc */
+    0,                    /* tp_traverse */
+    0,                    /* tp_clear */
+    0,                    /* tp_richcompare */
+    0,                    /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    pyhistogram_methods,  /* tp_methods */
+    pyhistogram_members,  /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    0,                    /* tp_init */
+    0,                    /* tp_alloc */
+    pyhistogram_new_type, /* tp_new */
+    0,                    /* tp_free */
+};
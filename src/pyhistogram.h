@@ -0,0 +1,51 @@
+/*
+ * Python Bindings for libevent
+ *
+ * Copyright (c) 2010-2011 by Joachim Bauch, mail@joachim-bauch.de
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ___EVENT_PYHISTOGRAM__H___
+#define ___EVENT_PYHISTOGRAM__H___
+
+#include <Python.h>
+
+// Values are recorded in microseconds. Values below 2^(SUB_BITS+1) are
+// counted exactly, larger values in 2^SUB_BITS buckets per power of two,
+// so the relative error of a bucket is at most 1/2^SUB_BITS.
+#define PYHISTOGRAM_SUB_BITS 4
+#define PYHISTOGRAM_SUB_COUNT (1 << PYHISTOGRAM_SUB_BITS)
+#define PYHISTOGRAM_MAX_SHIFT 40
+#define PYHISTOGRAM_BUCKETS ((PYHISTOGRAM_MAX_SHIFT + 2) * PYHISTOGRAM_SUB_COUNT)
+
+typedef struct _PyHistogramObject {
+    PyObject_HEAD
+    unsigned PY_LONG_LONG count;
+    unsigned PY_LONG_LONG min;
+    unsigned PY_LONG_LONG max;
+    double total;
+    unsigned PY_LONG_LONG buckets[PYHISTOGRAM_BUCKETS];
+} PyHistogramObject;
+
+extern PyTypeObject PyHistogram_Type;
+
+extern PyHistogramObject *pyhistogram_new(void);
+extern void pyhistogram_record(PyHistogramObject *self, unsigned PY_LONG_LONG value);
+extern void pyhistogram_reset(PyHistogramObject *self);
+
+#define PyHistogram_Check(ob) ((ob)->ob_type == &PyHistogram_Type)
+
+#endif
@@ -47,6 +47,7 @@ typedef struct _PyHttpCallbackObject {
     PyObject *path;
     PyObject *callback;
     PyObject *userdata;
+    PyObject *argcache;
 } PyHttpCallbackObject;
 
 typedef struct _PyHttpRequestObject {
@@ -92,13 +93,16 @@ _pyhttp_new_callback(PyHttpServerObject *self, char *path, PyObject *callback, P
     Py_INCREF(callback);
     result->userdata = userdata;
     Py_INCREF(userdata);
+    result->argcache = NULL;
     return result;
 }
 
+PyFreeList pyhttp_request_freelist = PYFREELIST_INIT("http_request", &PyHttpRequest_Type);
+
 static PyHttpRequestObject *
 _pyhttp_new_request(PyHttpServerObject *self, struct evhttp_request *request)
 {
-    PyHttpRequestObject *result = (PyHttpRequestObject *) PyHttpRequest_Type.tp_alloc(&PyHttpRequest_Type, 0);
+    PyHttpRequestObject *result = (PyHttpRequestObject *) pyfreelist_alloc(&pyhttp_request_freelist, &PyHttpRequest_Type);
     if (result == NULL) {
         return NULL;
     }
@@ -259,20 +263,25 @@ static void
 _pyhttp_invoke_callback(struct evhttp_request *req, void *userdata)
 {
     PyHttpCallbackObject *cb = (PyHttpCallbackObject *) userdata;
-    START_BLOCK_THREADS
+    START_BASE_BLOCK_THREADS(cb->http->base)
     PyHttpRequestObject *request = _pyhttp_new_request(cb->http, req);
     if (request == NULL) {
         pybase_store_error(cb->http->base);
     } else {
-        PyObject *result = PyObject_CallFunction(cb->callback, "OOO", cb->http, request, cb->userdata);
+        PyObject *argv[3] = {(PyObject *) cb->http, (PyObject *) request, cb->userdata};
+        PyObject *result;
+        // the callback might remove itself from the server
+        Py_INCREF(cb);
+        result = pybase_call(cb->http->base, PYBASE_CB_HTTP, cb->callback, &cb->argcache, 3, argv);
         if (result == NULL) {
             pybase_store_error(cb->http->base);
         } else {
             Py_DECREF(result);
         }
         Py_DECREF((PyObject *) request);
+        Py_DECREF(cb);
     }
-    END_BLOCK_THREADS
+    END_BASE_BLOCK_THREADS(cb->http->base)
 }
 
 PyDoc_STRVAR(pyhttp_set_callback_doc, "Set a callback for a specified URI.");
@@ -521,6 +530,7 @@ pyhttp_callback_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         s->path = NULL;
         s->callback = NULL;
         s->userdata = NULL;
+        s->argcache = NULL;
     }
     return (PyObject *)s;
 }
@@ -537,6 +547,7 @@ pyhttp_callback_dealloc(PyHttpCallbackObject *self)
     Py_XDECREF(self->path);
     Py_XDECREF(self->callback);
     Py_XDECREF(self->userdata);
+    Py_XDECREF(self->argcache);
     Py_TYPE(self)->tp_free(self);
 }
 
@@ -588,7 +599,7 @@ static PyObject *
 pyhttp_request_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
     PyHttpRequestObject *s;
-    s = (PyHttpRequestObject *)type->tp_alloc(type, 0);
+    s = (PyHttpRequestObject *)pyfreelist_alloc(&pyhttp_request_freelist, type);
     if (s != NULL) {
         s->http = NULL;
         s->request = NULL;
@@ -605,7 +616,9 @@ pyhttp_request_dealloc(PyHttpRequestObject *self)
         Py_END_ALLOW_THREADS
     }
     Py_XDECREF(self->http);
-    Py_TYPE(self)->tp_free(self);
+    if (!pyfreelist_release(&pyhttp_request_freelist, (PyObject *) self)) {
+        Py_TYPE(self)->tp_free(self);
+    }
 }
 
 PyDoc_STRVAR(pyhttp_request_send_error_doc, "Send an HTML error message to the client.");
@@ -651,9 +664,14 @@ pyhttp_request_send_reply(PyHttpRequestObject *self, PyObject *args)
     }
     
     if (PyEventBuffer_Check(pydata)) {
-        Py_BEGIN_ALLOW_THREADS
-        evhttp_send_reply(self->request, code, reason, ((PyBufferObject *) data)->buffer);
-        Py_END_ALLOW_THREADS
+        int exported;
+        // Drains the buffer
+        BEGIN_BUFFER_MODIFY((PyBufferObject *) pydata, exported)
+        evhttp_send_reply(self->request, code, reason, ((PyBufferObject *) pydata)->buffer);
+        END_BUFFER_MODIFY((PyBufferObject *) pydata, exported)
+        if (exported) {
+            return _pybuffer_exported_error();
+        }
     } else {
         struct evbuffer *buffer = NULL;
         if (PyObject_AsReadBuffer(pydata, (const void **) &data, &length) != 0) {
@@ -715,9 +733,14 @@ pyhttp_request_send_reply_chunk(PyHttpRequestObject *self, PyObject *args)
     }
     
     if (PyEventBuffer_Check(pydata)) {
-        Py_BEGIN_ALLOW_THREADS
-        evhttp_send_reply_chunk(self->request, ((PyBufferObject *) data)->buffer);
-        Py_END_ALLOW_THREADS
+        int exported;
+        // Drains the buffer
+        BEGIN_BUFFER_MODIFY((PyBufferObject *) pydata, exported)
+        evhttp_send_reply_chunk(self->request, ((PyBufferObject *) pydata)->buffer);
+        END_BUFFER_MODIFY((PyBufferObject *) pydata, exported)
+        if (exported) {
+            return _pybuffer_exported_error();
+        }
     } else {
         struct evbuffer *buffer;
         if (PyObject_AsReadBuffer(pydata, (const void **) &data, &length) != 0) {
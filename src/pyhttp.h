@@ -21,10 +21,13 @@
 #ifndef ___EVENT_PYHTTP__H___
 #define ___EVENT_PYHTTP__H___
 
+#include "pybase.h"
+
 extern PyTypeObject PyHttpServer_Type;
 extern PyTypeObject PyBoundSocket_Type;
 extern PyTypeObject PyHttpCallback_Type;
 extern PyTypeObject PyHttpRequest_Type;
+extern PyFreeList pyhttp_request_freelist;
 
 #define PyHttpServer_Check(ob) ((ob)->ob_type == &PyHttpServer_Type)
 #define PyBoundSocket_Check(ob) ((ob)->ob_type == &PyBoundSocket_Type)
@@ -33,6 +33,7 @@ typedef struct _PyListenerObject {
     PyObject *callback;
     PyObject *userdata;
     PyObject *weakrefs;
+    PyObject *argcache;
     int fd;
 } PyListenerObject;
 
@@ -40,14 +41,20 @@ static void
 pylistener_callback(struct evconnlistener *listener, evutil_socket_t fd, struct sockaddr *addr, int socklen, void *userdata)
 {
     PyListenerObject *self = (PyListenerObject *) userdata;
-    START_BLOCK_THREADS
-    PyObject *result = PyObject_CallFunction(self->callback, "OiO", self, fd, self->userdata);
+    START_BASE_BLOCK_THREADS(self->base)
+    PyObject *pyfd = PyInt_FromLong(fd);
+    PyObject *argv[3] = {(PyObject *) self, pyfd, self->userdata};
+    PyObject *result = NULL;
+    if (pyfd != NULL) {
+        result = pybase_call(self->base, PYBASE_CB_LISTENER, self->callback, &self->argcache, 3, argv);
+        Py_DECREF(pyfd);
+    }
     if (result == NULL) {
         pybase_store_error(self->base);
     } else {
         Py_DECREF(result);
     }
-    END_BLOCK_THREADS
+    END_BASE_BLOCK_THREADS(self->base)
 }
 
 static PyObject *
@@ -60,6 +67,7 @@ pylistener_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         s->callback = NULL;
         s->userdata = NULL;
         s->weakrefs = NULL;
+        s->argcache = NULL;
     }
     return (PyObject *)s;
 }
@@ -118,6 +126,7 @@ pylistener_clear(PyListenerObject *self)
     Py_CLEAR(self->callback);
     Py_CLEAR(self->userdata);
     Py_CLEAR(self->base);
+    Py_CLEAR(self->argcache);
     return 0;
 }
 
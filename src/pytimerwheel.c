@@ -0,0 +1,538 @@
+/*
+ * Python Bindings for libevent
+ *
+ * Copyright (c) 2010-2011 by Joachim Bauch, mail@joachim-bauch.de
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <Python.h>
+#include <structmember.h>
+
+#include <event2/event.h>
+
+#include "pybase.h"
+#include "pytimerwheel.h"
+
+// Hierarchical timing wheel with 4 levels of 256 slots. Timers expiring
+// within 256 ticks are kept in the first level, later ones in the higher
+// levels and moved down once their slot comes up.
+#define WHEEL_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_TICKS ((((unsigned PY_LONG_LONG) 1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+// List of timers that are being fired
+#define WHEEL_FIRING (WHEEL_LEVELS * WHEEL_SLOTS)
+#define WHEEL_LISTS (WHEEL_FIRING + 1)
+#define WHEEL_NIL ((unsigned int) -1)
+
+// Timers are stored in a slab and identified by their index and a
+// generation that changes whenever the entry is reused.
+struct pytimerwheel_entry {
+    unsigned int next;
+    unsigned int prev;
+    unsigned int generation;
+    unsigned int list;
+    unsigned PY_LONG_LONG expires;
+    PyObject *callback;
+    PyObject *userdata;
+};
+
+typedef struct _PyTimerWheelObject {
+    PyObject_HEAD
+    PyEventBaseObject *base;
+    struct event *tick;
+    double resolution;
+    double start;
+    unsigned PY_LONG_LONG current;
+    struct pytimerwheel_entry *entries;
+    unsigned int capacity;
+    unsigned int free;
+    Py_ssize_t count;
+    unsigned int lists[WHEEL_LISTS];
+    PyObject *argcache;
+    PyObject *weakrefs;
+} PyTimerWheelObject;
+
+static unsigned PY_LONG_LONG
+pytimerwheel_now(PyTimerWheelObject *self)
+{
+    return (unsigned PY_LONG_LONG) ((pybase_monotonic() - self->start) / self->resolution);
+}
+
+static void
+pytimerwheel_link(PyTimerWheelObject *self, unsigned int idx, unsigned int list)
+{
+    struct pytimerwheel_entry *entry = &self->entries[idx];
+    entry->list = list;
+    entry->prev = WHEEL_NIL;
+    entry->next = self->lists[list];
+    if (entry->next != WHEEL_NIL) {
+        self->entries[entry->next].prev = idx;
+    }
+    self->lists[list] = idx;
+}
+
+static void
+pytimerwheel_unlink(PyTimerWheelObject *self, unsigned int idx)
+{
+    struct pytimerwheel_entry *entry = &self->entries[idx];
+    if (entry->prev == WHEEL_NIL) {
+        self->lists[entry->list] = entry->next;
+    } else {
+        self->entries[entry->prev].next = entry->next;
+    }
+    if (entry->next != WHEEL_NIL) {
+        self->entries[entry->next].prev = entry->prev;
+    }
+}
+
+static void
+pytimerwheel_insert(PyTimerWheelObject *self, unsigned int idx)
+{
+    struct pytimerwheel_entry *entry = &self->entries[idx];
+    unsigned PY_LONG_LONG delta;
+    int level;
+    if (entry->expires < self->current) {
+        entry->expires = self->current;
+    }
+    delta = entry->expires - self->current;
+    if (delta > WHEEL_MAX_TICKS) {
+        delta = WHEEL_MAX_TICKS;
+        entry->expires = self->current + delta;
+    }
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (delta < (((unsigned PY_LONG_LONG) 1) << (WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+    pytimerwheel_link(self, idx, level * WHEEL_SLOTS +
+        (unsigned int) ((entry->expires >> (WHEEL_BITS * level)) & WHEEL_MASK));
+}
+
+// Move the timers of a slot in a higher level to the lower levels
+static void
+pytimerwheel_cascade(PyTimerWheelObject *self, int level, unsigned int slot)
+{
+    unsigned int list = level * WHEEL_SLOTS + slot;
+    unsigned int idx = self->lists[list];
+    self->lists[list] = WHEEL_NIL;
+    while (idx != WHEEL_NIL) {
+        unsigned int next = self->entries[idx].next;
+        pytimerwheel_insert(self, idx);
+        idx = next;
+    }
+}
+
+static void
+pytimerwheel_release(PyTimerWheelObject *self, unsigned int idx)
+{
+    struct pytimerwheel_entry *entry = &self->entries[idx];
+    entry->generation++;
+    entry->list = WHEEL_NIL;
+    entry->next = self->free;
+    self->free = idx;
+    self->count--;
+}
+
+static void
+pytimerwheel_stop(PyTimerWheelObject *self)
+{
+    if (self->count == 0 && self->tick != NULL) {
+        // Don't keep the loop running without timers
+        Py_BEGIN_ALLOW_THREADS
+        event_del(self->tick);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+// Fire all timers of a tick, must be called with the GIL held
+static void
+pytimerwheel_run_tick(PyTimerWheelObject *self, unsigned PY_LONG_LONG tick)
+{
+    int level;
+    unsigned int idx;
+    unsigned int slot = (unsigned int) (tick & WHEEL_MASK);
+    for (level = 1; slot == 0 && level < WHEEL_LEVELS; level++) {
+        slot = (unsigned int) ((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        pytimerwheel_cascade(self, level, slot);
+    }
+    
+    // Timers added by the callbacks must not be fired by this tick
+    self->current = tick + 1;
+    idx = self->lists[tick & WHEEL_MASK];
+    self->lists[WHEEL_FIRING] = idx;
+    self->lists[tick & WHEEL_MASK] = WHEEL_NIL;
+    while (idx != WHEEL_NIL) {
+        self->entries[idx].list = WHEEL_FIRING;
+        idx = self->entries[idx].next;
+    }
+    while (self->lists[WHEEL_FIRING] != WHEEL_NIL) {
+        idx = self->lists[WHEEL_FIRING];
+        struct pytimerwheel_entry *entry = &self->entries[idx];
+        PyObject *callback = entry->callback;
+        PyObject *userdata = entry->userdata;
+        PyObject *pyid;
+        PyObject *result = NULL;
+        
+        pyid = PyLong_FromUnsignedLongLong((((unsigned PY_LONG_LONG) entry->generation) << 32) | idx);
+        entry->callback = NULL;
+        entry->userdata = NULL;
+        pytimerwheel_unlink(self, idx);
+        pytimerwheel_release(self, idx);
+        if (pyid != NULL) {
+            PyObject *argv[3] = {(PyObject *) self, pyid, userdata};
+            result = pybase_call(self->base, PYBASE_CB_TIMERWHEEL, callback, &self->argcache, 3, argv);
+            Py_DECREF(pyid);
+        }
+        if (result == NULL) {
+            pybase_store_error(self->base);
+        } else {
+            Py_DECREF(result);
+        }
+        Py_DECREF(callback);
+        Py_DECREF(userdata);
+    }
+}
+
+static void
+pytimerwheel_callback(evutil_socket_t fd, short what, void *userdata)
+{
+    PyTimerWheelObject *self = (PyTimerWheelObject *) userdata;
+    PyEventBaseObject *base = self->base;
+    START_BASE_BLOCK_THREADS(base)
+    unsigned PY_LONG_LONG now = pytimerwheel_now(self);
+    // The wheel could be released by a callback
+    Py_INCREF(self);
+    Py_INCREF(base);
+    while (self->current <= now && self->count > 0 && self->base->error_type == NULL) {
+        pytimerwheel_run_tick(self, self->current);
+    }
+    if (self->count == 0) {
+        self->current = now + 1;
+    }
+    pytimerwheel_stop(self);
+    Py_DECREF(self);
+    Py_DECREF(base);
+    END_BASE_BLOCK_THREADS(base)
+}
+
+static PyObject *
+pytimerwheel_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyTimerWheelObject *s = (PyTimerWheelObject *)type->tp_alloc(type, 0);
+    if (s != NULL) {
+        int i;
+        s->base = NULL;
+        s->tick = NULL;
+        s->entries = NULL;
+        s->capacity = 0;
+        s->free = WHEEL_NIL;
+        s->count = 0;
+        s->current = 0;
+        for (i = 0; i < WHEEL_LISTS; i++) {
+            s->lists[i] = WHEEL_NIL;
+        }
+        s->argcache = NULL;
+        s->weakrefs = NULL;
+    }
+    return (PyObject *)s;
+}
+
+static int
+pytimerwheel_init(PyTimerWheelObject *self, PyObject *args, PyObject *kwds)
+{
+    PyEventBaseObject *base;
+    double resolution = 0.01;
+    if (!PyArg_ParseTuple(args, "O!|d", &PyEventBase_Type, &base, &resolution))
+        return -1;
+
+    if (resolution <= 0) {
+        PyErr_SetString(PyExc_TypeError, "the resolution must be positive");
+        return -1;
+    }
+
+    self->tick = event_new(base->base, -1, EV_PERSIST, pytimerwheel_callback, self);
+    if (self->tick == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    
+    self->base = base;
+    Py_INCREF(base);
+    self->resolution = resolution;
+    self->start = pybase_monotonic();
+    return 0;
+}
+
+static int
+pytimerwheel_traverse(PyTimerWheelObject *self, visitproc visit, void *arg)
+{
+    unsigned int i;
+    for (i = 0; i < self->capacity; i++) {
+        Py_VISIT(self->entries[i].callback);
+        Py_VISIT(self->entries[i].userdata);
+    }
+    Py_VISIT(self->base);
+    return 0;
+}
+
+static int
+pytimerwheel_clear(PyTimerWheelObject *self)
+{
+    unsigned int i;
+    Py_BEGIN_ALLOW_THREADS
+    if (self->tick != NULL) {
+        event_free(self->tick);
+        self->tick = NULL;
+    }
+    Py_END_ALLOW_THREADS
+    for (i = 0; i < self->capacity; i++) {
+        Py_CLEAR(self->entries[i].callback);
+        Py_CLEAR(self->entries[i].userdata);
+    }
+    if (self->entries != NULL) {
+        PyMem_Free(self->entries);
+        self->entries = NULL;
+    }
+    self->capacity = 0;
+    self->free = WHEEL_NIL;
+    self->count = 0;
+    for (i = 0; i < WHEEL_LISTS; i++) {
+        self->lists[i] = WHEEL_NIL;
+    }
+    Py_CLEAR(self->base);
+    Py_CLEAR(self->argcache);
+    return 0;
+}
+
+static void
+pytimerwheel_dealloc(PyTimerWheelObject *self)
+{
+    if (self->weakrefs != NULL) {
+        PyObject_ClearWeakRefs((PyObject *) self);
+    }
+    pytimerwheel_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static int
+pytimerwheel_grow(PyTimerWheelObject *self)
+{
+    unsigned int capacity = self->capacity ? self->capacity * 2 : 64;
+    unsigned int i;
+    struct pytimerwheel_entry *entries;
+    if (capacity <= self->capacity || capacity == WHEEL_NIL) {
+        PyErr_SetString(PyExc_TypeError, "too many timers");
+        return -1;
+    }
+    
+    entries = PyMem_Realloc(self->entries, capacity * sizeof(struct pytimerwheel_entry));
+    if (entries == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    
+    // Chain the new entries into the free list
+    for (i = self->capacity; i < capacity; i++) {
+        entries[i].next = (i + 1 < capacity) ? i + 1 : self->free;
+        entries[i].prev = WHEEL_NIL;
+        entries[i].generation = 1;
+        entries[i].list = WHEEL_NIL;
+        entries[i].callback = NULL;
+        entries[i].userdata = NULL;
+    }
+    self->free = self->capacity;
+    self->entries = entries;
+    self->capacity = capacity;
+    return 0;
+}
+
+PyDoc_STRVAR(pytimerwheel_add_doc, "Call callback(wheel, id, userdata) after delay seconds, returns the id of the timer.");
+
+static PyObject *
+pytimerwheel_add(PyTimerWheelObject *self, PyObject *args)
+{
+    double delay;
+    PyObject *callback;
+    PyObject *userdata = Py_None;
+    struct pytimerwheel_entry *entry;
+    unsigned int idx;
+    unsigned PY_LONG_LONG now;
+    double ticks;
+    if (!PyArg_ParseTuple(args, "dO|O", &delay, &callback, &userdata))
+        return NULL;
+
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "the callback must be callable");
+        return NULL;
+    }
+
+    if (self->free == WHEEL_NIL && pytimerwheel_grow(self) != 0) {
+        return NULL;
+    }
+
+    now = pytimerwheel_now(self);
+    if (self->count == 0) {
+        // The wheel didn't advance while it was empty, but it might already
+        // be past now when the last timer re-adds from its callback
+        struct timeval tv;
+        if (now > self->current) {
+            self->current = now;
+        }
+        timeval_init(&tv, self->resolution);
+        Py_BEGIN_ALLOW_THREADS
+        event_add(self->tick, &tv);
+        Py_END_ALLOW_THREADS
+    }
+    
+    idx = self->free;
+    entry = &self->entries[idx];
+    self->free = entry->next;
+    self->count++;
+    
+    // Round up, so the timer never fires early
+    ticks = delay > 0 ? delay / self->resolution : 0;
+    if (ticks > (double) WHEEL_MAX_TICKS) {
+        ticks = (double) WHEEL_MAX_TICKS;
+    }
+    entry->expires = now + (unsigned PY_LONG_LONG) ticks;
+    if ((double) (unsigned PY_LONG_LONG) ticks < ticks) {
+        entry->expires++;
+    }
+    entry->callback = callback;
+    Py_INCREF(callback);
+    entry->userdata = userdata;
+    Py_INCREF(userdata);
+    pytimerwheel_insert(self, idx);
+    return PyLong_FromUnsignedLongLong((((unsigned PY_LONG_LONG) entry->generation) << 32) | idx);
+}
+
+PyDoc_STRVAR(pytimerwheel_cancel_doc, "Cancel a timer, returns False if it already fired or was cancelled.");
+
+static PyObject *
+pytimerwheel_cancel(PyTimerWheelObject *self, PyObject *args)
+{
+    unsigned PY_LONG_LONG id;
+    unsigned int idx;
+    struct pytimerwheel_entry *entry;
+    PyObject *callback;
+    PyObject *userdata;
+    if (!PyArg_ParseTuple(args, "K", &id))
+        return NULL;
+
+    idx = (unsigned int) (id & 0xffffffff);
+    if (idx >= self->capacity) {
+        Py_RETURN_FALSE;
+    }
+    
+    entry = &self->entries[idx];
+    if (entry->list == WHEEL_NIL || entry->generation != (unsigned int) (id >> 32)) {
+        Py_RETURN_FALSE;
+    }
+    
+    callback = entry->callback;
+    userdata = entry->userdata;
+    entry->callback = NULL;
+    entry->userdata = NULL;
+    pytimerwheel_unlink(self, idx);
+    pytimerwheel_release(self, idx);
+    pytimerwheel_stop(self);
+    Py_DECREF(callback);
+    Py_DECREF(userdata);
+    Py_RETURN_TRUE;
+}
+
+static Py_ssize_t
+pytimerwheel_length(PyTimerWheelObject *self)
+{
+    return self->count;
+}
+
+static PyMethodDef
+pytimerwheel_methods[] = {
+    {"add", (PyCFunction)pytimerwheel_add, METH_VARARGS, pytimerwheel_add_doc},
+    {"cancel", (PyCFunction)pytimerwheel_cancel, METH_VARARGS, pytimerwheel_cancel_doc},
+    {NULL, NULL},
+};
+
+static PyMemberDef
+pytimerwheel_members[] = {
+    {"base", T_OBJECT, offsetof(PyTimerWheelObject, base), READONLY, "the base this wheel is assigned to"},
+    {"resolution", T_DOUBLE, offsetof(PyTimerWheelObject, resolution), READONLY, "the duration of a tick in seconds"},
+    {"capacity", T_UINT, offsetof(PyTimerWheelObject, capacity), READONLY, "number of allocated timer slots"},
+    {NULL}
+};
+
+static PySequenceMethods
+pytimerwheel_as_seq = {
+    (lenfunc)pytimerwheel_length,  /*sq_length*/
+    NULL,  /*sq_concat*/
+    NULL,  /*sq_repeat*/
+    NULL,  /*sq_item*/
+    NULL,  /*sq_slice*/
+    NULL,  /*sq_ass_item*/
+    NULL,  /*sq_ass_slice*/
+    NULL,  /*sq_contains*/
+    NULL,  /*sq_inplace_concat*/
+    NULL   /*sq_inplace_repeat*/
+};
+
+PyDoc_STRVAR(pytimerwheel_doc, "Hierarchical timing wheel for large numbers of coarse timers");
+
+PyTypeObject
+PyTimerWheel_Type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                    /* tp_internal */
+    "event.TimerWheel",   /* tp_name */
+    sizeof(PyTimerWheelObject), /* tp_basicsize */
+    0,                    /* tp_itemsize */
+    (destructor)pytimerwheel_dealloc, /* tp_dealloc */
+    0,                    /* tp_print */
+    0,                    /* tp_getattr */
+    0,                    /* tp_setattr */
+    0,                    /* tp_compare */
+    0,                    /* tp_repr */
+    0,                    /* tp_as_number */
+    &pytimerwheel_as_seq, /* tp_as_sequence */
+    0,                    /* tp_as_mapping */
+    0,                    /* tp_hash */
+    0,                    /* tp_call */
+    0,                    /* tp_str */
+    0,                    /* tp_getattro */
+    0,                    /* tp_setattro */
+    0,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_GC|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_WEAKREFS,   /* tp_flags */
+    pytimerwheel_doc,     /* tp_doc */
+    (traverseproc)pytimerwheel_traverse, /* tp_traverse */
+    (inquiry)pytimerwheel_clear, /* tp_clear */
+    0,                    /* tp_richcompare */
+    offsetof(PyTimerWheelObject, weakrefs),  /* tp_weaklistoffset */
+    0,                    /* tp_iter */
+    0,                    /* tp_iternext */
+    pytimerwheel_methods, /* tp_methods */
+    pytimerwheel_members, /* tp_members */
+    0,                    /* tp_getset */
+    0,                    /* tp_base */
+    0,                    /* tp_dict */
+    0,                    /* tp_descr_get */
+    0,                    /* tp_descr_set */
+    0,                    /* tp_dictoffset */
+    (initproc)pytimerwheel_init, /* tp_init */
+    0,                    /* tp_alloc */
+    pytimerwheel_new,     /* tp_new */
+    0,                    /* tp_free */
+};
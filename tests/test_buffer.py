@@ -1,4 +1,5 @@
 import os
+import struct
 import unittest
 
 import libevent
@@ -68,6 +69,162 @@ class TestBuffer(unittest.TestCase):
         self.failUnlessEqual(line, 'foo')
         self.failIf(bool(buf))
 
+    def test_subclass_freelist(self):
+        class MyBuffer(libevent.Buffer):
+            pass
+        libevent.Buffer()
+        stats = libevent.freelist_stats()['buffer']
+        # subclasses are not taken from the freelist of the buffers
+        buf = MyBuffer()
+        buf.add('data')
+        self.failUnlessEqual(buf.remove(4), 'data')
+        del buf
+        self.failUnlessEqual(libevent.freelist_stats()['buffer'], stats)
+        buf = self.createBuffer()
+        self.failUnlessEqual(libevent.freelist_stats()['buffer']['hits'], stats['hits'] + 1)
+
+    def test_buffer_protocol(self):
+        buf = self.createBuffer()
+        buf.add(struct.pack('!HI', 1, 2))
+        view = memoryview(buf)
+        self.failUnless(view.readonly)
+        self.failUnlessEqual(view.tobytes(), struct.pack('!HI', 1, 2))
+        self.failUnlessEqual(struct.unpack_from('!HI', buf), (1, 2))
+        # The buffer is pinned while the view is exported
+        self.failUnlessRaises(TypeError, buf.add, 'data')
+        self.failUnlessRaises(TypeError, buf.remove, 2)
+        self.failUnlessRaises(TypeError, buf.drain, 2)
+        self.failUnlessRaises(TypeError, buf.pullup)
+        other = self.createBuffer()
+        other.add('data')
+        self.failUnlessRaises(TypeError, other.add, buf)
+        self.failUnlessRaises(TypeError, buf.add, other)
+        self.failUnlessEqual(len(other), 4)
+        self.failUnlessEqual(view[0], '\x00')
+        del view
+        buf.add('data')
+        self.failUnlessEqual(len(buf), 10)
+        self.failUnlessEqual(buf.remove(6), struct.pack('!HI', 1, 2))
+
+    def test_buffer_protocol_frozen(self):
+        buf = self.createBuffer()
+        buf.add('data')
+        buf.freeze(1)
+        view = memoryview(buf)
+        del view
+        # Exports don't touch the ends frozen by the user
+        self.failUnlessRaises(TypeError, buf.remove, 2)
+        buf.add('more')
+        buf.unfreeze(1)
+        self.failUnlessEqual(buf.remove(), 'datamore')
+
+    def test_view(self):
+        buf = self.createBuffer()
+        buf.add('12')
+        buf.add('34')
+        buf.add('56')
+        view = buf.view(4)
+        self.failUnlessEqual(view.tobytes(), '1234')
+        del view
+        self.failUnlessEqual(buf.view().tobytes(), '123456')
+        self.failUnlessEqual(len(buf.view(0)), 0)
+        self.failUnlessRaises(TypeError, buf.view, 7)
+        self.failUnlessEqual(buf.remove(), '123456')
+        self.failUnlessEqual(len(buf.view()), 0)
+
+    def test_view_exported(self):
+        buf = self.createBuffer()
+        buf.add('12')
+        buf.add('34')
+        view = memoryview(buf)
+        self.failUnlessEqual(view.tobytes(), '12')
+        # The first chain is already contiguous, the rest would be moved
+        self.failUnlessEqual(buf.view(2).tobytes(), '12')
+        self.failUnlessRaises(BufferError, buf.view, 4)
+        del view
+        self.failUnlessEqual(buf.view(4).tobytes(), '1234')
+
+    def test_peek(self):
+        buf = self.createBuffer()
+        buf.add('1234')
+        buf.add('5678')
+        segments = buf.peek(-1)
+        self.failUnlessEqual(''.join(segment.tobytes() for segment in segments), '12345678')
+        self.failUnless(all(segment.readonly for segment in segments))
+        self.failUnlessEqual(''.join(segment.tobytes() for segment in buf.peek(6)), '123456')
+        self.failUnlessEqual(''.join(segment.tobytes() for segment in buf.peek(3, 4)), '567')
+        self.failUnlessEqual(buf.peek(0, 8), [])
+        self.failUnlessRaises(TypeError, buf.peek, 1, 9)
+        self.failUnlessRaises(TypeError, buf.peek, 1, -1)
+        # Peeking doesn't drain the buffer
+        self.failUnlessEqual(len(buf), 8)
+
+    def test_peek_pinned(self):
+        buf = self.createBuffer()
+        buf.add(struct.pack('!HI', 1, 2))
+        buf.add('A' * 100)
+        segments = buf.peek(-1)
+        segment = segments[-1]
+        del segments
+        self.failUnlessEqual(struct.unpack_from('!HI', buf.peek(6)[0]), (1, 2))
+        # The views pin the buffer, so they never read freed chains
+        self.failUnlessRaises(TypeError, buf.drain, 106)
+        self.failUnlessRaises(TypeError, buf.add, 'B' * 5000)
+        self.failUnlessEqual(segment[0], 'A')
+        self.failUnlessEqual(segment[1:3].tobytes(), 'AA')
+        del segment
+        buf.drain(106)
+        self.failUnlessEqual(len(buf), 0)
+
+    def test_reserve_commit(self):
+        buf = self.createBuffer()
+        buf.add('head')
+        segments = buf.reserve(6)
+        self.failIf(segments[0].readonly)
+        self.failUnless(sum(len(segment) for segment in segments) >= 6)
+        struct.pack_into('!HI', segments[0], 0, 1, 2)
+        # Reserved space isn't part of the buffer until it is committed
+        self.failUnlessEqual(len(buf), 4)
+        buf.commit(6)
+        self.failUnlessEqual(len(buf), 10)
+        # The views pin the buffer
+        self.failUnlessRaises(TypeError, buf.remove)
+        del segments
+        self.failUnlessEqual(buf.remove(), 'head' + struct.pack('!HI', 1, 2))
+        self.failUnlessRaises(TypeError, buf.commit, 0)
+
+    def test_reserve_commit_invalid(self):
+        buf = self.createBuffer()
+        self.failUnlessRaises(TypeError, buf.reserve, 0)
+        segments = buf.reserve(4)
+        self.failUnlessRaises(TypeError, buf.commit, sum(len(segment) for segment in segments) + 1)
+        self.failUnlessRaises(TypeError, buf.commit, -1)
+        # Reserving again would move the reserved space
+        self.failUnlessRaises(TypeError, buf.reserve, 4)
+        buf.commit(0)
+        self.failUnlessEqual(len(buf), 0)
+        del segments
+        segments = buf.reserve(4)
+        del segments
+        # Other modifications drop the reservation
+        buf.add('data')
+        self.failUnlessRaises(TypeError, buf.commit, 4)
+        self.failUnlessEqual(buf.remove(), 'data')
+
+    def test_reserve_pinned(self):
+        buf = self.createBuffer()
+        segment = buf.reserve(4096)[0]
+        self.failUnlessRaises(TypeError, buf.add, 'x' * 10)
+        self.failUnlessRaises(TypeError, buf.drain, 10)
+        self.failUnlessRaises(TypeError, buf.prepend, 'x' * 10)
+        # Writing through the view never touches freed memory
+        segment[:] = 'Z' * len(segment)
+        segment[0] = 'A'
+        buf.commit(2)
+        segment[1] = 'B'
+        del segment
+        self.failUnlessEqual(buf.remove(), 'AB')
+
 def suite():
     suite = unittest.TestSuite()
 
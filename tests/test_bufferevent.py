@@ -1,5 +1,9 @@
+import functools
 import gc
 import os
+import signal
+import socket
+import threading
 import unittest
 import weakref
 
@@ -18,6 +22,13 @@ class TestBufferEvent(unittest.TestCase):
         buf = self.createBufferEvent(base)
         self.failUnlessEqual(buf.bucket, None)
 
+    def test_set_timeouts(self):
+        base = self.createBase()
+        buf = self.createBufferEvent(base)
+        buf.set_timeouts(1.5, 0)
+        buf.set_timeouts(base.common_timeout(30), None)
+        self.failUnlessRaises(TypeError, buf.set_timeouts, self.createBase().common_timeout(30), None)
+
     def test_recursive_callback(self):
         class A:
             def __init__(self, buf):
@@ -42,11 +53,201 @@ class TestBufferEvent(unittest.TestCase):
         self.failUnlessEqual(r1(), None)
         self.failUnlessEqual(r2(), None)
 
+    def test_replace_running_callback(self):
+        base = self.createBase()
+        sock1, sock2 = socket.socketpair()
+        buf = self.createBufferEvent(base, sock1.fileno())
+        alive = []
+        def readable(bev, userdata):
+            # the running callback is only referenced by the bufferevent
+            bev.set_callbacks(None, None, None)
+            alive.append(ref() is not None)
+        callback = functools.partial(readable)
+        ref = weakref.ref(callback)
+        buf.set_callbacks(callback, None, None)
+        del callback
+        buf.enable(libevent.EV_READ)
+        sock2.send('data')
+        base.loop(libevent.EVLOOP_ONCE)
+        self.failUnlessEqual(alive, [True])
+        self.failUnlessEqual(ref(), None)
+        sock1.close()
+        sock2.close()
+
+    def test_buffers_not_exported(self):
+        base = self.createBase()
+        sock1, sock2 = socket.socketpair()
+        buf = self.createBufferEvent(base, sock1.fileno())
+        buf.output.add('data')
+        # libevent drains and refills the buffers of a bufferevent itself
+        self.failUnlessRaises(BufferError, memoryview, buf.output)
+        self.failUnlessRaises(BufferError, buf.input.view)
+        self.failUnlessRaises(BufferError, buf.output.peek, -1)
+        # ...and keeps the input frozen at the end until it reads
+        self.failUnlessRaises(TypeError, buf.input.add, 'data')
+        # the buffers are released with the bufferevent
+        input = buf.input
+        del buf
+        gc.collect()
+        self.failUnlessRaises(TypeError, input.view)
+        self.failUnlessRaises(TypeError, input.view, 1)
+        sock1.close()
+        sock2.close()
+
+    def test_buffer_lock_order(self):
+        # moving data between the buffers of threadsafe bufferevents from
+        # two threads must take their locks in the same order
+        base = self.createBase()
+        bev1 = self.createBufferEvent(base, -1, libevent.BEV_OPT_THREADSAFE)
+        bev2 = self.createBufferEvent(base, -1, libevent.BEV_OPT_THREADSAFE)
+        errors = []
+        def run(move):
+            try:
+                for i in xrange(20000):
+                    move()
+            except Exception, e:
+                errors.append(e)
+        def add():
+            bev1.output.add(bev2.input)
+            bev2.output.add(bev1.input)
+        def write():
+            bev1.write(bev2.input)
+            bev2.write(bev1.input)
+        threads = [threading.Thread(target=run, args=(move, )) for move in (add, write) * 2]
+        for thread in threads:
+            thread.daemon = True
+            thread.start()
+        for thread in threads:
+            thread.join(10)
+            self.failIf(thread.isAlive())
+        self.failUnlessEqual(errors, [])
+
+    def test_gil_batching_threadsafe(self):
+        # Batching keeps the GIL while libevent takes the bufferevent lock,
+        # another thread holding that lock would wait for the GIL forever.
+        base = self.createBase()
+        buf = self.createBufferEvent(base, -1, libevent.BEV_OPT_THREADSAFE)
+        self.failUnlessRaises(TypeError, base.set_gil_batching, True)
+        del buf
+        gc.collect()
+        base.set_gil_batching(True)
+        self.failUnlessRaises(TypeError, self.createBufferEvent, base, -1, libevent.BEV_OPT_THREADSAFE)
+        buf = self.createBufferEvent(base)
+        base.set_gil_batching(False)
+        buf = self.createBufferEvent(base, -1, libevent.BEV_OPT_THREADSAFE)
+
+class TestBasePool(unittest.TestCase):
+
+    def createPool(self, *args):
+        return libevent.BasePool(*args)
+
+    def _connect(self, pool, count):
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.bind(('127.0.0.1', 0))
+        server.listen(5)
+        server.setblocking(False)
+        accepted = []
+        done = threading.Event()
+        def connected(bev, userdata):
+            accepted.append((threading.currentThread().name, bev))
+            bev.write('hello')
+            if len(accepted) == count:
+                done.set()
+        base = libevent.Base()
+        pool.start()
+        try:
+            listener = pool.listen(base, server.fileno(), connected, flags=libevent.LEV_OPT_REUSEABLE)
+            clients = []
+            for i in xrange(count):
+                client = socket.create_connection(server.getsockname())
+                clients.append(client)
+            base.loopexit(0.2)
+            base.loop()
+            done.wait(2)
+            self.failUnless(done.isSet(), 'not all connections were dispatched')
+            for client in clients:
+                self.failUnlessEqual(client.recv(5), 'hello')
+                client.close()
+            return accepted
+        finally:
+            pool.stop()
+            server.close()
+
+    def test_round_robin(self):
+        pool = self.createPool(2)
+        accepted = self._connect(pool, 4)
+        self.failUnlessEqual(pool.connections(), [2, 2])
+        names = sorted(name for name, _ in accepted)
+        self.failUnlessEqual(names, ['BasePool-0', 'BasePool-0', 'BasePool-1', 'BasePool-1'])
+        del accepted
+        gc.collect()
+        self.failUnlessEqual(pool.connections(), [0, 0])
+
+    def test_least_loaded(self):
+        pool = self.createPool(3, libevent.BasePool.LEAST_LOADED)
+        accepted = self._connect(pool, 2)
+        self.failUnlessEqual(sorted(pool.connections()), [0, 1, 1])
+
+    def test_invalid(self):
+        self.failUnlessRaises(TypeError, self.createPool, 0)
+        self.failUnlessRaises(TypeError, self.createPool, 1, 'random')
+
+class TestPreforkServer(unittest.TestCase):
+
+    def _request(self, address):
+        client = socket.create_connection(address)
+        try:
+            return int(client.recv(32))
+        finally:
+            client.close()
+
+    def test_prefork(self):
+        def setup(base, sockets, idx):
+            def accepted(listener, fd, userdata):
+                os.write(fd, str(os.getpid()))
+                os.close(fd)
+            return [libevent.Listener(base, accepted, 0, 0, sock.fileno())
+                for sock in sockets]
+        server = libevent.PreforkServer(2, setup, [('127.0.0.1', 0)],
+            stats_interval=0.05)
+        server._MIN_LIFETIME = 0.1
+        address = server.addresses[0]
+        results = {}
+        def serve(fd, what, userdata):
+            pids = set(self._request(address) for i in xrange(20))
+            results['pids'] = pids
+            results['workers'] = set(server.workers())
+            # a crashed worker is restarted
+            os.kill(min(pids), signal.SIGKILL)
+            server.base.once(-1, libevent.EV_TIMEOUT, restarted, 0.5)
+        def restarted(fd, what, userdata):
+            results['restarted'] = set(server.workers())
+            results['pids2'] = set(self._request(address) for i in xrange(20))
+            server.base.once(-1, libevent.EV_TIMEOUT, finished, 0.2)
+        def finished(fd, what, userdata):
+            results['stats'] = server.stats()
+            server.stop()
+        server.base.once(-1, libevent.EV_TIMEOUT, serve, 0.3)
+        server.base.once(-1, libevent.EV_TIMEOUT, lambda *args: server.stop(), 5)
+        server.run()
+        self.failUnlessEqual(server.workers(), [])
+        # the connections are balanced between the workers
+        self.failUnlessEqual(results['pids'], results['workers'])
+        self.failUnlessEqual(len(results['restarted']), 2)
+        self.failUnlessEqual(len(results['restarted'] & results['workers']), 1)
+        self.failUnlessEqual(results['pids2'], results['restarted'])
+        stats = results['stats']
+        self.failUnlessEqual(stats['workers'], 2)
+        self.failUnlessEqual(stats['restarts'], 1)
+        self.failUnless(stats['listener_callbacks'] >= 20, stats)
+
 def suite():
     suite = unittest.TestSuite()
 
     test_cases = [
         TestBufferEvent,
+        TestBasePool,
+        TestPreforkServer,
     ]
 
     for tc in test_cases:
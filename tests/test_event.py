@@ -1,6 +1,11 @@
+import gc
 import os
+import subprocess
+import sys
 import unittest
 import threading
+import time
+import weakref
 try:
     import signal
 except ImportError:
@@ -18,11 +23,11 @@ class TestEventBase(unittest.TestCase):
     def createConfig(self):
         return libevent.Config()
         
-    def createTimer(self, *args):
-        return libevent.Timer(*args)
+    def createTimer(self, *args, **kwargs):
+        return libevent.Timer(*args, **kwargs)
     
-    def createSignal(self, *args):
-        return libevent.Signal(*args)
+    def createSignal(self, *args, **kwargs):
+        return libevent.Signal(*args, **kwargs)
     
     def fire_timer(self, _, evt):
         evt.set()
@@ -43,6 +48,21 @@ class TestEventBase(unittest.TestCase):
         base.loop()
         self.failIf(evt.isSet(), 'timer should not have been fired')
 
+    def test_timer_keywords(self):
+        calls = []
+        base = self.createBase()
+        t = self.createTimer(base, lambda evt, userdata: calls.append(userdata), userdata='data')
+        t.add(0.01)
+        base.loop()
+        self.failUnlessEqual(calls, ['data'])
+        t = self.createTimer(base=base, callback=self.fire_timer)
+        self.failUnlessEqual(t.userdata, None)
+        self.failUnlessRaises(TypeError, self.createTimer, base, self.fire_timer, data='data')
+        if signal is not None:
+            s = self.createSignal(base, signal.SIGUSR1, self.fire_signal, userdata='data')
+            self.failUnlessEqual(s.userdata, 'data')
+            self.failUnlessRaises(TypeError, self.createSignal, base, signal.SIGUSR1, self.fire_signal, data='data')
+
     def test_timer_noref(self):
         # a timer object without a reference doesn't fire
         evt = threading.Event()
@@ -63,6 +83,18 @@ class TestEventBase(unittest.TestCase):
         base.loop()
         self.failUnless(evt.isSet(), 'timer did not fire')
 
+    def test_timer_subclass(self):
+        class MyTimer(libevent.Timer):
+            pass
+        evt = threading.Event()
+        base = self.createBase()
+        t = MyTimer(base, self.fire_timer, evt)
+        self.failUnless(isinstance(t, libevent.Event))
+        self.failUnlessEqual(t.callback, self.fire_timer)
+        t.add(0.01)
+        base.loop()
+        self.failUnless(evt.isSet(), 'timer did not fire')
+
     def test_timer_delete(self):
         evt = threading.Event()
         base = self.createBase()
@@ -73,6 +105,497 @@ class TestEventBase(unittest.TestCase):
         base.loop()
         self.failIf(evt.isSet(), 'timer should not have been fired')
 
+    def test_timer_common_timeout(self):
+        evt = threading.Event()
+        base = self.createBase()
+        timeout = base.common_timeout(0.1)
+        self.failUnless(isinstance(timeout, libevent.CommonTimeout))
+        self.failUnlessEqual(timeout.duration, 0.1)
+        t = self.createTimer(base, self.fire_timer, evt)
+        t.add(timeout)
+        base.loopexit(0.2)
+        base.loop()
+        self.failUnless(evt.isSet(), 'timer did not fire')
+
+    def test_common_timeout_other_base(self):
+        base = self.createBase()
+        timeout = self.createBase().common_timeout(0.1)
+        t = self.createTimer(base, self.fire_timer, None)
+        self.failUnlessRaises(TypeError, t.add, timeout)
+
+    def test_once(self):
+        calls = []
+        def fired(fd, what, userdata):
+            calls.append((fd, what, userdata))
+        base = self.createBase()
+        base.once(-1, libevent.EV_TIMEOUT, fired, 0.01, 'data')
+        base.once(-1, libevent.EV_TIMEOUT, fired)
+        base.loop()
+        self.failUnlessEqual(calls, [(-1, libevent.EV_TIMEOUT, None), (-1, libevent.EV_TIMEOUT, 'data')])
+        self.failUnlessRaises(TypeError, base.once, -1, libevent.EV_TIMEOUT, None)
+
+    def test_once_freed_with_base(self):
+        class Data(object):
+            pass
+        data = Data()
+        ref = weakref.ref(data)
+        base = self.createBase()
+        base.once(-1, libevent.EV_TIMEOUT, lambda *args: None, 60, data)
+        del data
+        self.failIfEqual(ref(), None)
+        # The pending callback is released with the base
+        del base
+        self.failUnlessEqual(ref(), None)
+
+    def test_base_collected(self):
+        class Data(object):
+            pass
+        data = Data()
+        ref = weakref.ref(data)
+        base = self.createBase()
+        # Cycles through all references held by the base
+        data.base = base
+        base.once(-1, libevent.EV_TIMEOUT, lambda *args: None, 60, data)
+        base.call_soon_threadsafe(lambda *args: None, data)
+        base.set_callback_profiling(1, data.__init__)
+        base.callback_histograms['data'] = data
+        del data, base
+        gc.collect()
+        self.failUnlessEqual(ref(), None)
+
+    def test_stats(self):
+        def fired(evt, fd, what, userdata):
+            if userdata:
+                raise ValueError(userdata)
+        base = self.createBase()
+        base.set_stats_timing(True)
+        stats = base.stats()
+        self.failUnlessEqual(stats['loop_iterations'], 0)
+        self.failUnlessEqual(stats['event_callbacks'], 0)
+        evt = libevent.Event(base, -1, 0, fired)
+        evt.add(0.01)
+        base.once(-1, libevent.EV_TIMEOUT, lambda *args: None)
+        base.loop()
+        stats = base.stats()
+        self.failUnless(stats['loop_iterations'] >= 1)
+        self.failUnlessEqual(stats['event_callbacks'], 1)
+        self.failUnlessEqual(stats['once_callbacks'], 1)
+        self.failUnlessEqual(stats['errors'], 0)
+        self.failUnless(stats['callback_time'] > 0.0)
+        evt1 = libevent.Event(base, -1, 0, fired, 'first')
+        evt1.add(0.01)
+        evt2 = libevent.Event(base, -1, 0, fired, 'second')
+        evt2.add(0.01)
+        # an error stops the loop, the remaining event fires in the next one
+        self.failUnlessRaises(ValueError, base.loop)
+        self.failUnlessRaises(ValueError, base.loop)
+        self.failUnlessEqual(base.stats()['errors'], 2)
+        base.reset_stats()
+        stats = base.stats()
+        self.failUnlessEqual(stats['loop_iterations'], 0)
+        self.failUnlessEqual(stats['event_callbacks'], 0)
+        self.failUnlessEqual(stats['errors'], 0)
+
+    def test_callback_profiling(self):
+        slow = []
+        def fired(evt, fd, what, userdata):
+            if userdata:
+                time.sleep(userdata)
+        def hook(callback, name, duration):
+            slow.append((callback, name))
+        base = self.createBase()
+        self.failUnlessEqual(base.callback_histograms, None)
+        base.set_callback_profiling(0.05, hook)
+        evt1 = libevent.Event(base, -1, 0, fired)
+        evt1.add(0.01)
+        evt2 = libevent.Event(base, -1, 0, fired, 0.1)
+        evt2.add(0.02)
+        base.loop()
+        name = '%s.fired' % (__name__)
+        self.failUnlessEqual(slow, [(fired, name)])
+        self.failUnlessEqual(base.slow_callbacks, 1)
+        histogram = base.callback_histograms[name]
+        self.failUnlessEqual(histogram.count, 2)
+        self.failUnless(histogram.max() >= 0.1)
+        base.set_callback_profiling(None)
+        evt1.add(0.01)
+        base.loop()
+        self.failUnlessEqual(histogram.count, 2)
+
+    def test_timer_lag(self):
+        def fired(evt, userdata):
+            if userdata:
+                time.sleep(userdata)
+        base = self.createBase()
+        self.failUnlessEqual(base.timer_lag.count, 0)
+        t1 = self.createTimer(base, fired, 0.1)
+        t1.add(0.01)
+        t2 = self.createTimer(base, fired)
+        t2.add(0.02)
+        t3 = self.createTimer(base, fired)
+        t3.add()
+        t3.delete()
+        base.loop()
+        # the second timer was delayed by the first callback
+        lag = base.timer_lag
+        self.failUnlessEqual(lag.count, 2)
+        self.failUnless(lag.max() >= 0.05, lag.max())
+        base.reset_stats()
+        self.failUnlessEqual(lag.count, 0)
+
+    def test_call_soon_threadsafe(self):
+        calls = []
+        base = self.createBase()
+        def called(idx, thread):
+            calls.append((idx, thread))
+            if len(calls) == 2000:
+                base.loopbreak()
+        def submit(thread):
+            for i in xrange(1000):
+                base.call_soon_threadsafe(called, i, thread)
+        keepalive = self.createTimer(base, self.fire_timer, threading.Event())
+        keepalive.add(5)
+        threads = [threading.Thread(target=submit, args=(i, )) for i in xrange(2)]
+        for thread in threads:
+            thread.start()
+        base.loop()
+        for thread in threads:
+            thread.join()
+        self.failUnlessEqual(len(calls), 2000)
+        for thread in xrange(2):
+            # callbacks of a thread are run in the order they were submitted
+            self.failUnlessEqual([idx for idx, t in calls if t == thread], range(1000))
+        stats = base.stats()
+        self.failUnlessEqual(stats['soon_callbacks'], 2000)
+        self.failUnless(stats['loop_iterations'] < 2000)
+        self.failUnlessRaises(TypeError, base.call_soon_threadsafe)
+        self.failUnlessRaises(TypeError, base.call_soon_threadsafe, None)
+
+    def test_loopbreak_other_thread(self):
+        base = self.createBase()
+        ticker = libevent.Event(base, -1, libevent.EV_PERSIST, lambda *args: None)
+        ticker.add(0.0001)
+        for i in xrange(20):
+            thread = threading.Thread(target=base.loop)
+            thread.start()
+            time.sleep(0.01)
+            # lands between the iterations of the loop most of the time
+            base.loopbreak()
+            thread.join(5)
+            self.failIf(thread.isAlive())
+        ticker.delete()
+
+    def test_activate(self):
+        calls = []
+        def fired(evt, fd, what, userdata):
+            calls.append((userdata, what))
+        base = self.createBase()
+        events = [libevent.Event(base, -1, 0, fired, i) for i in xrange(3)]
+        events[0].activate(libevent.EV_READ)
+        base.loop()
+        self.failUnlessEqual(calls, [(0, libevent.EV_READ)])
+        del calls[:]
+        base.activate_many(events, libevent.EV_WRITE)
+        base.loop()
+        self.failUnlessEqual(sorted(calls), [(i, libevent.EV_WRITE) for i in xrange(3)])
+        other = libevent.Event(self.createBase(), -1, 0, fired)
+        self.failUnlessRaises(TypeError, base.activate_many, [other], libevent.EV_READ)
+        self.failUnlessRaises(TypeError, base.activate_many, [None], libevent.EV_READ)
+
+    def test_run_for(self):
+        calls = []
+        def fired(evt, fd, what, userdata):
+            calls.append(userdata)
+            if userdata == 'slow':
+                time.sleep(0.05)
+        base = self.createBase()
+        events = [libevent.Event(base, -1, 0, fired, i) for i in xrange(10)]
+        base.activate_many(events, libevent.EV_READ)
+        self.failUnlessEqual(base.run_for(None, 3), 3)
+        self.failUnlessEqual(len(calls), 3)
+        # the remaining events are still active
+        self.failUnlessEqual(base.run_for(None, 100), 7)
+        self.failUnlessEqual(sorted(calls), range(10))
+        del calls[:]
+        slow = [libevent.Event(base, -1, 0, fired, 'slow') for i in xrange(10)]
+        base.activate_many(slow, libevent.EV_READ)
+        self.failUnlessEqual(base.run_for(0.08), 2)
+        # waiting for events is limited as well
+        t = self.createTimer(base, self.fire_timer, threading.Event())
+        t.add(5)
+        start = time.time()
+        self.failUnlessEqual(base.run_for(0.6), 8)
+        self.failUnlessEqual(base.run_for(0.05), 0)
+        self.failUnless(time.time() - start < 1)
+        self.failUnlessRaises(TypeError, base.run_for, None, -1)
+
+    def test_run_for_call_soon(self):
+        calls = []
+        base = self.createBase()
+        for i in xrange(10):
+            base.call_soon_threadsafe(calls.append, i)
+        self.failUnlessEqual(base.run_for(None, 2), 2)
+        self.failUnlessEqual(calls, [0, 1])
+        # callbacks queued later run after the remaining ones
+        base.call_soon_threadsafe(calls.append, 10)
+        self.failUnlessEqual(base.run_for(None, 3), 3)
+        self.failUnlessEqual(base.run_for(None, 100), 6)
+        self.failUnlessEqual(calls, range(11))
+
+    def test_busy_poll(self):
+        calls = []
+        def fired(evt, fd, what, userdata):
+            calls.append(time.time())
+            if len(calls) == 20:
+                evt.base.loopbreak()
+        base = self.createBase()
+        base.set_busy_poll(0.01)
+        rfd, wfd = os.pipe()
+        def writer():
+            for i in xrange(20):
+                time.sleep(0.001)
+                os.write(wfd, 'x')
+        try:
+            evt = libevent.Event(base, rfd, libevent.EV_READ|libevent.EV_PERSIST,
+                lambda evt, fd, what, userdata: (os.read(fd, 1), fired(evt, fd, what, userdata)))
+            evt.add()
+            thread = threading.Thread(target=writer)
+            thread.start()
+            base.loop()
+            thread.join()
+        finally:
+            os.close(rfd)
+            os.close(wfd)
+        self.failUnlessEqual(len(calls), 20)
+        stats = base.stats()
+        self.failUnless(stats['spin_hits'] > 0, stats)
+        self.failUnlessEqual(stats['spin_hits'] + stats['spin_misses'], stats['loop_iterations'])
+        # the window adapts to the time between the writes
+        self.failUnless(0 < stats['busy_poll_window'] < 0.01, stats)
+        self.failUnlessRaises(TypeError, base.set_busy_poll, -1)
+
+    def test_now(self):
+        times = []
+        def fired(evt, userdata):
+            times.append((evt.base.now(), evt.base.now(), time.time()))
+        base = self.createBase()
+        self.failUnless(abs(base.now() - time.time()) < 0.1)
+        start = base.monotonic()
+        t = self.createTimer(base, fired)
+        t.add_at(base.now() + 0.05)
+        t2 = self.createTimer(base, fired)
+        t2.add_at(base.now() - 10)
+        base.loop()
+        self.failUnlessEqual(len(times), 2)
+        for cached, cached2, now in times:
+            # the time is cached while the callbacks are running
+            self.failUnlessEqual(cached, cached2)
+            self.failUnless(abs(cached - now) < 0.1)
+        self.failUnless(base.monotonic() - start >= 0.04)
+        self.failUnlessEqual(base.timer_lag.count, 2)
+        persist = libevent.Event(base, -1, libevent.EV_PERSIST, fired)
+        self.failUnlessRaises(TypeError, persist.add_at, base.now() + 1)
+
+    def test_periodic_timer(self):
+        ticks = []
+        def tick(timer, userdata):
+            ticks.append((timer.deadline, base.monotonic()))
+            # the runtime of the callback must not delay the next tick
+            time.sleep(0.01)
+            if len(ticks) == 5:
+                timer.stop()
+        base = self.createBase()
+        timer = libevent.PeriodicTimer(base, 0.03, tick)
+        self.failUnlessEqual(timer.policy, libevent.PERIODIC_SKIP)
+        start = base.monotonic()
+        timer.start()
+        first = timer.deadline
+        self.failUnless(first >= start + 0.03, first - start)
+        base.loop()
+        self.failUnlessEqual(len(ticks), 5)
+        self.failUnlessEqual(timer.ticks, 5)
+        for deadline, when in ticks:
+            self.failUnless(when + 0.000001 >= deadline, (deadline, when))
+            # the deadlines stay on the schedule of the first tick
+            steps = (deadline - first) / 0.03
+            self.failUnlessAlmostEqual(steps, round(steps), 6)
+        self.failUnlessEqual(round((ticks[-1][0] - first) / 0.03) + 1,
+            timer.ticks + timer.missed)
+        self.failUnlessEqual(base.timer_lag.count, 5)
+        self.failUnlessRaises(TypeError, libevent.PeriodicTimer, base, 0, tick)
+        self.failUnlessRaises(TypeError, libevent.PeriodicTimer, base, 1, tick, None, 3)
+        self.failUnlessRaises(TypeError, libevent.PeriodicTimer, base, 1, tick, policy=12345)
+        timer = libevent.PeriodicTimer(base, 1, tick, userdata='data', policy=libevent.PERIODIC_CATCH_UP)
+        self.failUnlessEqual(timer.userdata, 'data')
+        self.failUnlessEqual(timer.policy, libevent.PERIODIC_CATCH_UP)
+
+    def test_periodic_timer_missed(self):
+        def run(policy):
+            ticks = []
+            def tick(timer, userdata):
+                ticks.append((timer.deadline, base.monotonic(), timer.missed))
+                if len(ticks) == 1:
+                    # block the loop for more than three intervals
+                    time.sleep(0.17)
+                elif len(ticks) == 4:
+                    timer.stop()
+            base = self.createBase()
+            timer = libevent.PeriodicTimer(base, 0.05, tick, None, policy)
+            timer.start(0)
+            base.loop()
+            self.failUnlessEqual(len(ticks), 4)
+            for deadline, when, missed in ticks:
+                self.failUnless(when + 0.000001 >= deadline, (deadline, when))
+            return timer, ticks
+        timer, ticks = run(libevent.PERIODIC_SKIP)
+        (first, _, _), (deadline, _, missed) = ticks[:2]
+        self.failUnless(missed >= 3, missed)
+        # the phase of the schedule is kept
+        self.failUnlessAlmostEqual(deadline - first, (missed + 1) * 0.05, 6)
+        timer, ticks = run(libevent.PERIODIC_COALESCE)
+        (first, _, _), (deadline, _, missed), (restart, _, _) = ticks[:3]
+        # one call for the missed ticks, then the schedule restarts
+        self.failUnless(deadline - first >= 0.17, deadline - first)
+        self.failUnlessEqual(missed, int((deadline - first) / 0.05) - 1)
+        self.failUnlessAlmostEqual(restart - deadline, 0.05, 6)
+        timer, ticks = run(libevent.PERIODIC_CATCH_UP)
+        self.failUnlessEqual(timer.missed, 0)
+        first = ticks[0][0]
+        for idx, (deadline, when, missed) in enumerate(ticks):
+            self.failUnlessAlmostEqual(deadline - first, idx * 0.05, 6)
+        # the missed ticks are run after the blocked callback
+        for deadline, when, missed in ticks[1:]:
+            self.failUnless(when >= first + 0.17, when - first)
+
+    def test_freelist(self):
+        base = self.createBase()
+        max_size = libevent.freelist_stats()['event']['max_size']
+        libevent.set_freelist_size('event', 2)
+        try:
+            events = [self.createTimer(base, lambda *args: None) for i in xrange(4)]
+            del events
+            stats = libevent.freelist_stats()['event']
+            self.failUnlessEqual(stats['size'], 2)
+            self.failUnlessEqual(stats['max_size'], 2)
+            fired = []
+            timer = self.createTimer(base, lambda evt, userdata: fired.append(userdata), 'data')
+            self.failUnlessEqual(libevent.freelist_stats()['event']['hits'], stats['hits'] + 1)
+            # recycled objects start from a clean state
+            self.failUnlessEqual(timer.fd, -1)
+            timer.add(0.01)
+            base.loop()
+            self.failUnlessEqual(fired, ['data'])
+            self.failUnlessRaises(TypeError, libevent.set_freelist_size, 'unknown', 1)
+        finally:
+            libevent.set_freelist_size('event', max_size)
+
+    def test_sub_interpreter(self):
+        try:
+            import ctypes
+        except ImportError:
+            return
+        code = '''if 1:
+            import sys
+            sys.path[:] = %r
+            import libevent
+            sys.marker = True
+            seen = []
+            def fired(evt, userdata):
+                # imports must use the modules of the sub-interpreter
+                import sys
+                seen.append(getattr(sys, 'marker', False))
+            for batch in (False, True):
+                base = libevent.Base()
+                base.set_gil_batching(batch)
+                timer = libevent.Timer(base, fired)
+                timer.add(0.01)
+                base.loop()
+            assert seen == [True, True], seen
+            try:
+                libevent.set_log_callback(None)
+            except TypeError:
+                pass
+            else:
+                raise AssertionError('log callback set by a sub-interpreter')
+        ''' % (sys.path, )
+        # The sub-interpreter runs in a child process, which exits without
+        # returning to its main interpreter. The bytecode between the ctypes
+        # calls runs with the thread state of the sub-interpreter and must
+        # not release the GIL.
+        driver = '''if 1:
+            import ctypes, os, sys
+            sys.setcheckinterval(2 ** 31 - 1)
+            api = ctypes.pythonapi
+            api.Py_NewInterpreter.restype = ctypes.c_void_p
+            api.PyRun_SimpleString.argtypes = [ctypes.c_char_p]
+            api.Py_NewInterpreter()
+            os._exit(api.PyRun_SimpleString(sys.argv[1]))
+        '''
+        process = subprocess.Popen([sys.executable, '-c', driver, code],
+            stderr=subprocess.PIPE)
+        _, errors = process.communicate()
+        self.failUnlessEqual(process.returncode, 0, errors)
+
+    def test_event_callback_args(self):
+        # callbacks may keep a reference to their arguments
+        calls = []
+        def fired(*args):
+            calls.append(args)
+        base = self.createBase()
+        evt = libevent.Event(base, -1, 0, fired, 'data')
+        evt.add(0.01)
+        base.loop()
+        evt.add(0.01)
+        base.loop()
+        self.failUnlessEqual(len(calls), 2)
+        for args in calls:
+            self.failUnlessEqual(args, (evt, -1, libevent.EV_TIMEOUT, 'data'))
+
+    def test_event_callback_args_gc(self):
+        # the recycled argument tuples must not be reachable while cached
+        base = self.createBase()
+        timer = self.createTimer(base, lambda *args: None)
+        timer.add(0.01)
+        base.loop()
+        for obj in gc.get_objects():
+            if type(obj) is tuple:
+                list(obj)
+        timer.add(0.01)
+        base.loop()
+
+    def test_gil_batching(self):
+        calls = []
+        def fired(evt, fd, what, userdata):
+            calls.append(what)
+        base = self.createBase()
+        base.set_gil_batching(True)
+        rfd, wfd = os.pipe()
+        try:
+            os.write(wfd, 'x')
+            events = [libevent.Event(base, rfd, libevent.EV_READ, fired) for i in xrange(10)]
+            for evt in events:
+                evt.add()
+            base.loop()
+        finally:
+            os.close(rfd)
+            os.close(wfd)
+        self.failUnlessEqual(calls, [libevent.EV_READ] * 10)
+        self.failUnlessEqual(base.gil_batches, 1)
+        self.failUnlessEqual(base.gil_handoffs_saved, 9)
+
+    def test_gil_batching_loopexit(self):
+        evt = threading.Event()
+        base = self.createBase()
+        base.set_gil_batching(True)
+        t = self.createTimer(base, self.fire_timer, evt)
+        t.add(0.1)
+        t2 = self.createTimer(base, self.fire_timer, threading.Event())
+        t2.add(1)
+        base.loopexit(0.2)
+        base.loop()
+        self.failUnless(evt.isSet(), 'timer did not fire')
+        self.failUnless(base.got_exit())
+
     if signal is not None:
         
         def test_signal(self):
@@ -95,6 +618,56 @@ class TestEventBase(unittest.TestCase):
                 cfg.avoid_method(m)
             base = self.createBase(cfg)
             self.failUnlessEqual(method, base.method)
+
+    def test_cfg_max_dispatch_interval(self):
+        def run(cfg):
+            calls = []
+            base = self.createBase(cfg)
+            base.priority_init(2)
+            rfd, wfd = os.pipe()
+            def fired(evt, fd, what, userdata):
+                calls.append(userdata)
+                if userdata == 0:
+                    # only noticed when the loop polls for events again
+                    os.write(wfd, 'x')
+            try:
+                high = libevent.Event(base, rfd, libevent.EV_READ, fired, 'high')
+                high.set_priority(0)
+                high.add()
+                events = [libevent.Event(base, -1, 0, fired, i) for i in xrange(10)]
+                for evt in events:
+                    evt.set_priority(1)
+                base.activate_many(events, libevent.EV_READ)
+                base.loop()
+            finally:
+                os.close(rfd)
+                os.close(wfd)
+            return calls.index('high')
+        self.failUnlessEqual(run(self.createConfig()), 10)
+        cfg = self.createConfig()
+        cfg.set_max_dispatch_interval(None, 1, 1)
+        self.failUnlessEqual(run(cfg), 1)
+        cfg.set_max_dispatch_interval(0.001, -1, 1)
+
+    def test_cfg_nolock(self):
+        self.failIf(self.createBase().nolock)
+        cfg = self.createConfig()
+        cfg.set_flag(libevent.EVENT_BASE_FLAG_NOLOCK)
+        base = self.createBase(cfg)
+        self.failUnless(base.nolock)
+        # calls that keep the GIL behave the same
+        calls = []
+        t = self.createTimer(base, lambda evt, userdata: calls.append(userdata), 'timer')
+        t.add(60)
+        t.delete()
+        t.add(0.01)
+        t.set_priority(0)
+        self.failIf(base.got_exit())
+        base.loop()
+        self.failUnlessEqual(calls, ['timer'])
+        base.loopexit(0)
+        base.loop()
+        self.failUnless(base.got_exit())
     
 def suite():
     suite = unittest.TestSuite()
@@ -0,0 +1,51 @@
+import unittest
+
+import libevent
+
+class TestHistogram(unittest.TestCase):
+
+    def createHistogram(self):
+        return libevent.Histogram()
+    
+    def test_empty(self):
+        h = self.createHistogram()
+        self.failUnlessEqual(h.count, 0)
+        self.failUnlessEqual(h.mean(), 0.0)
+        self.failUnlessEqual(h.percentile(99), 0.0)
+        self.failUnlessEqual(h.buckets(), [])
+
+    def test_record(self):
+        h = self.createHistogram()
+        for i in xrange(1, 101):
+            h.record(i / 1000.0)
+        self.failUnlessEqual(h.count, 100)
+        self.failUnlessAlmostEqual(h.min(), 0.001)
+        self.failUnlessAlmostEqual(h.max(), 0.1)
+        self.failUnlessAlmostEqual(h.mean(), 0.0505)
+        # buckets have a relative error of at most 1/16
+        for p in (10, 50, 90, 99):
+            value = h.percentile(p)
+            self.failUnless(abs(value - p / 1000.0) <= p / 1000.0 / 16, (p, value))
+        self.failUnlessEqual(h.percentile(100), h.max())
+        self.failUnlessEqual(sum(count for _, _, count in h.buckets()), 100)
+        for lower, upper, count in h.buckets():
+            self.failUnless(lower <= upper)
+        h.reset()
+        self.failUnlessEqual(h.count, 0)
+        self.failUnlessRaises(TypeError, h.record, -1)
+        self.failUnlessRaises(TypeError, h.percentile, 101)
+
+def suite():
+    suite = unittest.TestSuite()
+
+    test_cases = [
+        TestHistogram,
+    ]
+
+    for tc in test_cases:
+        suite.addTest(unittest.makeSuite(tc))
+
+    return suite
+
+if __name__ == '__main__':
+    unittest.main(defaultTest='suite')
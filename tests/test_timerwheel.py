@@ -0,0 +1,93 @@
+import time
+import unittest
+
+import libevent
+
+class TestTimerWheel(unittest.TestCase):
+
+    def createBase(self):
+        return libevent.Base()
+
+    def createTimerWheel(self, *args):
+        return libevent.TimerWheel(*args)
+
+    def test_fire(self):
+        fired = []
+        def callback(wheel, id, userdata):
+            fired.append((userdata, time.time() - start))
+        base = self.createBase()
+        wheel = self.createTimerWheel(base, 0.001)
+        start = time.time()
+        # the last timers are beyond the first level of the wheel
+        delays = [0.02, 0.005, 0, 0.3, 0.01, 0.6]
+        ids = [wheel.add(delay, callback, delay) for delay in delays]
+        self.failUnlessEqual(len(set(ids)), len(ids))
+        self.failUnlessEqual(len(wheel), len(delays))
+        base.loop()
+        self.failUnlessEqual(len(wheel), 0)
+        self.failUnlessEqual([delay for delay, _ in fired], sorted(delays))
+        for delay, elapsed in fired:
+            self.failUnless(elapsed >= delay, (delay, elapsed))
+            self.failUnless(elapsed < delay + 0.1, (delay, elapsed))
+        self.failIf(wheel.cancel(ids[0]))
+        self.failUnlessEqual(base.stats()['timerwheel_callbacks'], len(delays))
+
+    def test_cancel(self):
+        fired = []
+        def callback(wheel, id, userdata):
+            fired.append(userdata)
+            if userdata == 'first':
+                self.failUnless(wheel.cancel(ids[2]))
+                wheel.add(0.005, callback, 'added')
+        base = self.createBase()
+        wheel = self.createTimerWheel(base, 0.001)
+        ids = [wheel.add(0.001, callback, 'first'),
+            wheel.add(0.01, callback, 'cancelled'),
+            wheel.add(0.01, callback, 'cancelled in callback'),
+            wheel.add(0.05, callback, 'last')]
+        self.failUnless(wheel.cancel(ids[1]))
+        self.failIf(wheel.cancel(ids[1]))
+        self.failIf(wheel.cancel(12345))
+        base.loop()
+        self.failUnlessEqual(fired, ['first', 'added', 'last'])
+        # entries are reused with a new id
+        new_id = wheel.add(1, callback)
+        self.failIf(new_id in ids)
+        self.failUnless(wheel.cancel(new_id))
+
+    def test_add_from_callback(self):
+        fired = []
+        def callback(wheel, id, userdata):
+            fired.append(time.time())
+            self.failUnlessEqual(len(wheel), 0)
+            if len(fired) < 5:
+                wheel.add(0.01, callback)
+        base = self.createBase()
+        wheel = self.createTimerWheel(base, 0.001)
+        start = time.time()
+        wheel.add(0.01, callback)
+        base.loop()
+        self.failUnlessEqual(len(fired), 5)
+        for previous, when in zip([start] + fired, fired):
+            self.failUnless(when - previous >= 0.01, when - previous)
+
+    def test_invalid(self):
+        base = self.createBase()
+        self.failUnlessRaises(TypeError, self.createTimerWheel, base, 0)
+        wheel = self.createTimerWheel(base)
+        self.failUnlessRaises(TypeError, wheel.add, 1, None)
+
+def suite():
+    suite = unittest.TestSuite()
+
+    test_cases = [
+        TestTimerWheel,
+    ]
+
+    for tc in test_cases:
+        suite.addTest(unittest.makeSuite(tc))
+
+    return suite
+
+if __name__ == '__main__':
+    unittest.main(defaultTest='suite')